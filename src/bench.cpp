@@ -0,0 +1,298 @@
+// Headless microbenchmarks for the rules code and the search
+//   bench [rounds]                     slider lookup timings
+//   bench eval [rounds] [network]      incremental evaluation against a full recompute, and the
+//                                      network against the handcrafted evaluation when one is given
+//   bench search [depth]               single thread nodes, speed and move ordering quality
+//   bench smp [depth] [maxThreads]     Lazy SMP time-to-depth and nodes per second
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchpositions.h"
+#include "bitboard.h"
+#include "evaluate.h"
+#include "nnue.h"
+#include "position.h"
+#include "search.h"
+#include "tt.h"
+
+const int OCCUPANCY_SAMPLES = 4096;
+
+// Function to time a slider lookup over every square for each sampled occupancy
+template <typename Lookup>
+double timeLookups(const std::vector<Bitboard> &occupancies, int rounds, Bitboard &checksum, Lookup lookup)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; round++)
+	{
+		for (Bitboard occupied : occupancies)
+		{
+			for (int sq = 0; sq < 64; sq++)
+				checksum += lookup(sq, occupied);
+		}
+	}
+	auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	return elapsed / (double(rounds) * occupancies.size() * 64);
+}
+
+void benchSliders(int rounds)
+{
+	// Random boards with roughly a quarter of the squares occupied, like a middlegame
+	std::mt19937_64 rng(20250113);
+	std::vector<Bitboard> occupancies(OCCUPANCY_SAMPLES);
+	for (Bitboard &occupied : occupancies)
+		occupied = rng() & rng();
+
+	for (Bitboard occupied : occupancies)
+	{
+		for (int sq = 0; sq < 64; sq++)
+		{
+			if (rookAttacks(sq, occupied) != rookRayAttacks(sq, occupied) || bishopAttacks(sq, occupied) != bishopRayAttacks(sq, occupied))
+			{
+				std::cerr << "Magic lookup mismatch on square " << sq << std::endl;
+				return;
+			}
+		}
+	}
+
+	Bitboard checksum = 0;
+	double rookRay = timeLookups(occupancies, rounds, checksum, rookRayAttacks);
+	double rookMagic = timeLookups(occupancies, rounds, checksum, rookAttacks);
+	double bishopRay = timeLookups(occupancies, rounds, checksum, bishopRayAttacks);
+	double bishopMagic = timeLookups(occupancies, rounds, checksum, bishopAttacks);
+	double queenRay = timeLookups(occupancies, rounds, checksum, [](int sq, Bitboard occupied)
+								  { return rookRayAttacks(sq, occupied) | bishopRayAttacks(sq, occupied); });
+	double queenMagic = timeLookups(occupancies, rounds, checksum, queenAttacks);
+
+#ifdef USE_PEXT
+	std::cout << "Slider lookups (PEXT), ns per call" << std::endl;
+#else
+	std::cout << "Slider lookups (magic multiply), ns per call" << std::endl;
+#endif
+	std::cout << "  rook    ray " << rookRay << "  table " << rookMagic << "  speedup " << rookRay / rookMagic << "x" << std::endl;
+	std::cout << "  bishop  ray " << bishopRay << "  table " << bishopMagic << "  speedup " << bishopRay / bishopMagic << "x" << std::endl;
+	std::cout << "  queen   ray " << queenRay << "  table " << queenMagic << "  speedup " << queenRay / queenMagic << "x" << std::endl;
+	std::cout << "  (checksum " << checksum << ")" << std::endl;
+}
+
+// Function to time the incremental evaluation against summing every piece again, on positions
+// reached by random playouts from the bench positions
+void benchEval(int rounds)
+{
+	std::mt19937_64 rng(20250121);
+	std::vector<Position> positions;
+	for (const char *fen : BENCH_POSITIONS)
+	{
+		for (int game = 0; game < 64; game++)
+		{
+			Position position;
+			position.setFromFen(fen);
+			for (int ply = 0; ply < 40; ply++)
+			{
+				MoveList list;
+				position.generateLegalMoves(list);
+				if (list.size() == 0)
+					break;
+				UndoInfo undo;
+				position.makeMove(list.moves[rng() % list.size()], undo);
+				positions.push_back(position);
+			}
+		}
+	}
+
+	PawnTable pawns;
+	for (const Position &position : positions)
+	{
+		if (evaluate(position, pawns) != evaluateFromScratch(position))
+		{
+			std::cerr << "Incremental evaluation mismatch" << std::endl;
+			return;
+		}
+	}
+
+	auto timeEvals = [&](auto eval, int64_t &checksum)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int round = 0; round < rounds; round++)
+		{
+			for (const Position &position : positions)
+				checksum += eval(position);
+		}
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return double(rounds) * positions.size() / elapsed;
+	};
+
+	int64_t checksum = 0;
+	double full = timeEvals(evaluateFromScratch, checksum);
+	double incremental = timeEvals([&pawns](const Position &position)
+								   { return evaluate(position, pawns); },
+								   checksum);
+
+	std::cout << "Evaluation over " << positions.size() << " positions, evals per second" << std::endl;
+	std::cout << "  " << (NNUE.loaded() ? "network (" + std::string(NNUE.simdName()) + ")" : "handcrafted")
+			  << "  full recompute " << uint64_t(full) << "  incremental " << uint64_t(incremental) << "  speedup " << incremental / full << "x" << std::endl;
+	if (!NNUE.loaded())
+		std::cout << "  pawn cache hits " << 100.0 * double(pawns.hits()) / double(pawns.probes()) << "%" << std::endl;
+	std::cout << "  (checksum " << checksum << ")" << std::endl;
+}
+
+// Function to time a random playout with an evaluation at every step, which is what the search does
+// and includes the accumulator updates inside make and unmake
+double timePlayouts(int rounds, int64_t &checksum)
+{
+	std::mt19937_64 rng(20250122);
+	PawnTable pawns;
+	uint64_t evals = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (int round = 0; round < rounds; round++)
+	{
+		for (const char *fen : BENCH_POSITIONS)
+		{
+			Position position;
+			position.setFromFen(fen);
+			UndoInfo undo[40];
+			Move played[40];
+			int ply = 0;
+			for (; ply < 40; ply++)
+			{
+				MoveList list;
+				position.generateLegalMoves(list);
+				if (list.size() == 0)
+					break;
+				played[ply] = list.moves[rng() % list.size()];
+				position.makeMove(played[ply], undo[ply]);
+				checksum += evaluate(position, pawns);
+				evals++;
+			}
+			while (ply-- > 0)
+				position.unmakeMove(played[ply], undo[ply]);
+		}
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return evals / elapsed;
+}
+
+void benchNetwork(int rounds, const std::string &path)
+{
+	int64_t checksum = 0;
+	double handcrafted = timePlayouts(rounds, checksum);
+	if (!NNUE.load(path))
+	{
+		std::cerr << "Could not load network " << path << std::endl;
+		return;
+	}
+	benchEval(rounds);
+	double network = timePlayouts(rounds, checksum);
+	std::cout << "Make, evaluate and unmake per second: handcrafted " << uint64_t(handcrafted) << "  network " << uint64_t(network)
+			  << "  (" << handcrafted / network << "x slower, checksum " << checksum << ")" << std::endl;
+}
+
+// Function to search each position on one thread and report the node count, speed and how often
+// a beta cutoff came from the first move searched (the higher the better the move ordering)
+void benchSearch(int depth)
+{
+	TT.resize(64);
+	Search search;
+	SearchLimits limits;
+	limits.depth = depth;
+
+	uint64_t nodes = 0, cutoffs = 0, firstMoveCutoffs = 0, pawnProbes = 0, pawnHits = 0;
+	double totalMs = 0;
+	for (const char *fen : BENCH_POSITIONS)
+	{
+		Position position;
+		position.setFromFen(fen);
+		TT.clear();
+
+		auto start = std::chrono::steady_clock::now();
+		SearchResult result = search.run(position, std::vector<uint64_t>(), limits);
+		totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		nodes += result.nodes;
+		cutoffs += result.cutoffs;
+		firstMoveCutoffs += result.firstMoveCutoffs;
+		pawnProbes += result.pawnProbes;
+		pawnHits += result.pawnHits;
+
+		std::cout << "  " << moveToUci(result.bestMove) << "  score " << result.score << "  nodes " << result.nodes << "  first move cutoffs "
+				  << (result.cutoffs ? 100.0 * result.firstMoveCutoffs / result.cutoffs : 0) << "%" << std::endl;
+	}
+
+	std::cout << "Search depth " << depth << ": nodes " << nodes << "  time " << uint64_t(totalMs) << " ms  nps " << uint64_t(nodes * 1000 / (totalMs + 1))
+			  << "  first move cutoffs " << (cutoffs ? 100.0 * firstMoveCutoffs / cutoffs : 0) << "%"
+			  << "  pawn cache hits " << (pawnProbes ? 100.0 * pawnHits / pawnProbes : 0) << "%" << std::endl;
+}
+
+// Function to measure how Lazy SMP scales: every thread count searches the same positions
+// from an empty hash table, so time-to-depth and nodes per second compare directly
+void benchSmp(int depth, int maxThreads)
+{
+	TT.resize(64);
+	Search search;
+	SearchLimits limits;
+	limits.depth = depth;
+
+	std::cout << "Lazy SMP scaling, depth " << depth << ", " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	double baseTime = 0;
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		search.setThreads(threads);
+		uint64_t nodes = 0;
+		double totalMs = 0;
+		for (const char *fen : BENCH_POSITIONS)
+		{
+			Position position;
+			position.setFromFen(fen);
+			TT.clear(threads);
+
+			auto start = std::chrono::steady_clock::now();
+			SearchResult result = search.run(position, std::vector<uint64_t>(), limits);
+			totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			nodes += result.nodes;
+		}
+
+		if (threads == 1)
+			baseTime = totalMs;
+		std::cout << "  threads " << threads << "  time " << uint64_t(totalMs) << " ms  nps " << uint64_t(nodes * 1000 / (totalMs + 1))
+				  << "  time-to-depth speedup " << baseTime / totalMs << "x" << std::endl;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	auto start = std::chrono::steady_clock::now();
+	initBitboards();
+	auto initTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "initBitboards: " << initTime << " ms" << std::endl;
+
+	if (argc > 1 && std::string(argv[1]) == "smp")
+	{
+		int depth = argc > 2 ? std::stoi(argv[2]) : 12;
+		int maxThreads = argc > 3 ? std::stoi(argv[3]) : 16;
+		benchSmp(depth, maxThreads);
+		return 0;
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "eval")
+	{
+		int rounds = argc > 2 ? std::stoi(argv[2]) : 200;
+		benchEval(rounds);
+		if (argc > 3)
+			benchNetwork(rounds, argv[3]);
+		return 0;
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "search")
+	{
+		benchSearch(argc > 2 ? std::stoi(argv[2]) : 12);
+		return 0;
+	}
+
+	int rounds = argc > 1 ? std::stoi(argv[1]) : 20;
+	benchSliders(rounds);
+	return 0;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Middlegame positions the search reports use, each searched to the same fixed depth. The node
+// count of the uci bench command is taken over these, so changing them changes the signature
+static const char *const BENCH_POSITIONS[] = {
+	"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"r2q1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 9",
+	"2r3k1/pp3ppp/4pn2/3p4/3P4/2P1PN2/P4PPP/2R3K1 b - - 0 22"};
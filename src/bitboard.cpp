@@ -0,0 +1,138 @@
+#include "bitboard.h"
+
+Magic BishopMagics[64];
+Magic RookMagics[64];
+Bitboard BetweenTable[64][64];
+Bitboard LineTable[64][64];
+
+// Every relevant occupancy subset of every square shares one table per slider kind
+static Bitboard BishopTable[0x1480];
+static Bitboard RookTable[0x19000];
+
+static const int ROOK_DIRECTIONS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+static const int BISHOP_DIRECTIONS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+// Function to walk the four rays of a slider, stopping on the first occupied square of each ray
+static Bitboard slidingAttacks(const int directions[4][2], int sq, Bitboard occupied)
+{
+	Bitboard attacks = 0;
+	for (int d = 0; d < 4; d++)
+	{
+		int file = fileOf(sq) + directions[d][0];
+		int rank = rankOf(sq) + directions[d][1];
+		while (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+		{
+			Bitboard b = squareBB(makeSquare(file, rank));
+			attacks |= b;
+			if (occupied & b)
+				break;
+			file += directions[d][0];
+			rank += directions[d][1];
+		}
+	}
+	return attacks;
+}
+
+Bitboard bishopRayAttacks(int sq, Bitboard occupied)
+{
+	return slidingAttacks(BISHOP_DIRECTIONS, sq, occupied);
+}
+
+Bitboard rookRayAttacks(int sq, Bitboard occupied)
+{
+	return slidingAttacks(ROOK_DIRECTIONS, sq, occupied);
+}
+
+// Magic numbers found offline by trying sparse random candidates until no two occupancies
+// with different attacks collide, so startup only has to fill the tables
+static const Bitboard BISHOP_MAGICS[64] = {
+	0x40106000A1160020ULL, 0x0020010250810120ULL, 0x2010010220280081ULL, 0x002806004050C040ULL,
+	0x0002021018000000ULL, 0x2001112010000400ULL, 0x0881010120218080ULL, 0x1030820110010500ULL,
+	0x0000120222042400ULL, 0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422A02000001ULL,
+	0x000A220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL, 0x0100004042101040ULL,
+	0x0004001004082820ULL, 0x0010000810010048ULL, 0x1014004208081300ULL, 0x2080818802044202ULL,
+	0x0040880C00A00100ULL, 0x0080400200522010ULL, 0x0001000188180B04ULL, 0x0080249202020204ULL,
+	0x1004400004100410ULL, 0x00013100A0022206ULL, 0x2148500001040080ULL, 0x4241080011004300ULL,
+	0x4020848004002000ULL, 0x10101380D1004100ULL, 0x0008004422020284ULL, 0x01010A1041008080ULL,
+	0x0808080400082121ULL, 0x0808080400082121ULL, 0x0091128200100C00ULL, 0x0202200802010104ULL,
+	0x8C0A020200440085ULL, 0x01A0008080B10040ULL, 0x0889520080122800ULL, 0x100902022202010AULL,
+	0x04081A0816002000ULL, 0x0000681208005000ULL, 0x8170840041008802ULL, 0x0A00004200810805ULL,
+	0x0830404408210100ULL, 0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+	0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440A210428ULL, 0x0008240020880021ULL,
+	0x0400002012048200ULL, 0x00AC102001210220ULL, 0x0220021002009900ULL, 0x84440C080A013080ULL,
+	0x0001008044200440ULL, 0x0004C04410841000ULL, 0x2000500104011130ULL, 0x1A0C010011C20229ULL,
+	0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822C08200ULL, 0x48081010008A2A80ULL};
+
+static const Bitboard ROOK_MAGICS[64] = {
+	0x0880004000108025ULL, 0x8040004010002008ULL, 0x2080200010008008ULL, 0x1100100008210004ULL,
+	0xC200209084020008ULL, 0x2100010004000208ULL, 0x0400081000822421ULL, 0x0200010422048844ULL,
+	0x0800800080400024ULL, 0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+	0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL, 0x4040800080004100ULL,
+	0x0040048001458024ULL, 0x00A0004000205000ULL, 0x3100808010002000ULL, 0x4825010010000820ULL,
+	0x5004808008000401ULL, 0x2024818004000A00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+	0x0080400880008421ULL, 0x4062220600410280ULL, 0x010A004A00108022ULL, 0x0000100080080080ULL,
+	0x0021000500080010ULL, 0x0044000202001008ULL, 0x0000100400080102ULL, 0xC020128200040545ULL,
+	0x0080002000400040ULL, 0x0000804000802004ULL, 0x0000120022004080ULL, 0x010A386103001001ULL,
+	0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL, 0x000000490A000084ULL,
+	0x0080002000504000ULL, 0x200020005000C000ULL, 0x0012088020420010ULL, 0x0010010080080800ULL,
+	0x0085001008010004ULL, 0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+	0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL, 0x2008100208028080ULL,
+	0x5000850800910100ULL, 0x8402019004680200ULL, 0x0120911028020400ULL, 0x0000008044010200ULL,
+	0x0020850200244012ULL, 0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040A100021ULL,
+	0x000200282410A102ULL, 0x000200282410A102ULL, 0x000200282410A102ULL, 0x4048240043802106ULL};
+
+// Function to compute the mask of every square and fill its slice of the attack table
+static void initMagics(Bitboard table[], Magic magics[], const Bitboard magicNumbers[64], const int directions[4][2])
+{
+	int size = 0;
+
+	for (int sq = 0; sq < 64; sq++)
+	{
+		Magic &m = magics[sq];
+
+		// Board edges are not relevant unless the slider stands on them
+		Bitboard edges = ((RANK_1_BB | RANK_8_BB) & ~rankBB(sq)) | ((FILE_A_BB | FILE_H_BB) & ~fileBB(sq));
+		m.mask = slidingAttacks(directions, sq, 0) & ~edges;
+		m.magic = magicNumbers[sq];
+		m.shift = 64 - popcount(m.mask);
+		m.attacks = sq == 0 ? table : magics[sq - 1].attacks + size;
+
+		// Carry-Rippler trick to enumerate every subset of the mask
+		Bitboard b = 0;
+		size = 0;
+		do
+		{
+			m.attacks[m.index(b)] = slidingAttacks(directions, sq, b);
+			size++;
+			b = (b - m.mask) & m.mask;
+		} while (b);
+	}
+}
+
+void initBitboards()
+{
+	initMagics(BishopTable, BishopMagics, BISHOP_MAGICS, BISHOP_DIRECTIONS);
+	initMagics(RookTable, RookMagics, ROOK_MAGICS, ROOK_DIRECTIONS);
+
+	for (int a = 0; a < 64; a++)
+	{
+		for (int b = 0; b < 64; b++)
+		{
+			BetweenTable[a][b] = 0;
+			LineTable[a][b] = 0;
+			if (a == b)
+				continue;
+
+			if (rookAttacks(a, 0) & squareBB(b))
+			{
+				BetweenTable[a][b] = rookAttacks(a, squareBB(b)) & rookAttacks(b, squareBB(a));
+				LineTable[a][b] = (rookAttacks(a, 0) & rookAttacks(b, 0)) | squareBB(a) | squareBB(b);
+			}
+			else if (bishopAttacks(a, 0) & squareBB(b))
+			{
+				BetweenTable[a][b] = bishopAttacks(a, squareBB(b)) & bishopAttacks(b, squareBB(a));
+				LineTable[a][b] = (bishopAttacks(a, 0) & bishopAttacks(b, 0)) | squareBB(a) | squareBB(b);
+			}
+		}
+	}
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "types.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+constexpr Bitboard RANK_1_BB = 0xFFULL;
+constexpr Bitboard RANK_2_BB = RANK_1_BB << 8;
+constexpr Bitboard RANK_7_BB = RANK_1_BB << 48;
+constexpr Bitboard RANK_8_BB = RANK_1_BB << 56;
+constexpr Bitboard FILE_A_BB = 0x0101010101010101ULL;
+constexpr Bitboard FILE_H_BB = FILE_A_BB << 7;
+
+constexpr Bitboard squareBB(int sq)
+{
+	return 1ULL << sq;
+}
+
+constexpr Bitboard rankBB(int sq)
+{
+	return RANK_1_BB << (8 * rankOf(sq));
+}
+
+constexpr Bitboard fileBB(int sq)
+{
+	return FILE_A_BB << fileOf(sq);
+}
+
+inline int popcount(Bitboard b)
+{
+#ifdef _MSC_VER
+	return (int)__popcnt64(b);
+#else
+	return __builtin_popcountll(b);
+#endif
+}
+
+// Index of the least significant set bit, b must not be empty
+inline int lsb(Bitboard b)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, b);
+	return (int)index;
+#else
+	return __builtin_ctzll(b);
+#endif
+}
+
+inline int popLsb(Bitboard &b)
+{
+	int sq = lsb(b);
+	b &= b - 1;
+	return sq;
+}
+
+inline bool moreThanOne(Bitboard b)
+{
+	return (b & (b - 1)) != 0;
+}
+
+// Knight, king and pawn attacks never depend on occupancy, so the tables are built by the compiler
+constexpr int KNIGHT_OFFSETS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+constexpr int KING_OFFSETS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+constexpr int PAWN_OFFSETS[2][2][2] = {{{-1, 1}, {1, 1}}, {{-1, -1}, {1, -1}}};
+
+constexpr Bitboard leaperAttacks(int sq, const int offsets[][2], int count)
+{
+	Bitboard attacks = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int file = fileOf(sq) + offsets[i][0];
+		int rank = rankOf(sq) + offsets[i][1];
+		if (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+			attacks |= squareBB(makeSquare(file, rank));
+	}
+	return attacks;
+}
+
+struct LeaperTables
+{
+	Bitboard pawn[2][64];
+	Bitboard knight[64];
+	Bitboard king[64];
+};
+
+constexpr LeaperTables makeLeaperTables()
+{
+	LeaperTables tables = {};
+	for (int sq = 0; sq < 64; sq++)
+	{
+		tables.pawn[WHITE][sq] = leaperAttacks(sq, PAWN_OFFSETS[WHITE], 2);
+		tables.pawn[BLACK][sq] = leaperAttacks(sq, PAWN_OFFSETS[BLACK], 2);
+		tables.knight[sq] = leaperAttacks(sq, KNIGHT_OFFSETS, 8);
+		tables.king[sq] = leaperAttacks(sq, KING_OFFSETS, 8);
+	}
+	return tables;
+}
+
+constexpr LeaperTables LEAPER_ATTACKS = makeLeaperTables();
+
+static_assert(LEAPER_ATTACKS.knight[SQ_A1] == (squareBB(SQ_B3) | squareBB(SQ_C2)), "knight table");
+static_assert(LEAPER_ATTACKS.king[SQ_H8] == (squareBB(SQ_G8) | squareBB(SQ_G7) | squareBB(SQ_H7)), "king table");
+
+constexpr Bitboard pawnAttacks(Color color, int sq)
+{
+	return LEAPER_ATTACKS.pawn[color][sq];
+}
+
+constexpr Bitboard knightAttacks(int sq)
+{
+	return LEAPER_ATTACKS.knight[sq];
+}
+
+constexpr Bitboard kingAttacks(int sq)
+{
+	return LEAPER_ATTACKS.king[sq];
+}
+
+// Sliding attacks found by walking each ray until it hits a piece. Only used to fill
+// the magic tables and by the benchmark, movegen goes through the lookups below
+Bitboard bishopRayAttacks(int sq, Bitboard occupied);
+Bitboard rookRayAttacks(int sq, Bitboard occupied);
+
+// Fancy magic bitboards: the relevant occupancy is hashed to an index into a shared
+// attack table. Building with -DUSE_PEXT -mbmi2 replaces the multiply with a PEXT
+struct Magic
+{
+	Bitboard mask;
+	Bitboard magic;
+	Bitboard *attacks;
+	unsigned shift;
+
+	unsigned index(Bitboard occupied) const
+	{
+#ifdef USE_PEXT
+		return (unsigned)_pext_u64(occupied, mask);
+#else
+		return (unsigned)(((occupied & mask) * magic) >> shift);
+#endif
+	}
+};
+
+extern Magic BishopMagics[64];
+extern Magic RookMagics[64];
+extern Bitboard BetweenTable[64][64];
+extern Bitboard LineTable[64][64];
+
+// Finds the magics and fills the slider and line tables, must be called once before any Position is used
+void initBitboards();
+
+inline Bitboard bishopAttacks(int sq, Bitboard occupied)
+{
+	const Magic &m = BishopMagics[sq];
+	return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard rookAttacks(int sq, Bitboard occupied)
+{
+	const Magic &m = RookMagics[sq];
+	return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard queenAttacks(int sq, Bitboard occupied)
+{
+	return bishopAttacks(sq, occupied) | rookAttacks(sq, occupied);
+}
+
+// Squares strictly between two aligned squares (empty when not aligned)
+inline Bitboard betweenBB(int a, int b)
+{
+	return BetweenTable[a][b];
+}
+
+// Whole board line through two aligned squares (empty when not aligned)
+inline Bitboard lineBB(int a, int b)
+{
+	return LineTable[a][b];
+}
@@ -0,0 +1,190 @@
+#include "book.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "bitboard.h"
+#include "polyglot.h"
+
+const size_t BOOK_ENTRY_SIZE = 16;
+
+uint64_t polyglotKey(const Position &position)
+{
+	// Polyglot orders the kinds pawn, knight, bishop, rook, queen, king with black first
+	static const int KIND_INDEX[7] = {0, 0, 3, 1, 2, 4, 5};
+	uint64_t key = 0;
+	for (int sq = 0; sq < 64; sq++)
+	{
+		PieceType piece = position.pieceOn(sq);
+		if (piece != EMPTY)
+			key ^= POLYGLOT_RANDOM[64 * (2 * KIND_INDEX[pieceKind(piece)] + (pieceColor(piece) == WHITE)) + sq];
+	}
+
+	static const int RIGHTS[4] = {WHITE_OO, WHITE_OOO, BLACK_OO, BLACK_OOO};
+	for (int i = 0; i < 4; i++)
+	{
+		if (position.castling() & RIGHTS[i])
+			key ^= POLYGLOT_RANDOM[POLYGLOT_CASTLING + i];
+	}
+
+	// The file only counts when a pawn of the side to move stands next to the pawn that just moved
+	Color us = position.sideToMove();
+	int epSquare = position.enPassantSquare();
+	if (epSquare != SQ_NONE && (pawnAttacks(~us, epSquare) & position.pieces(us, PAWN)))
+		key ^= POLYGLOT_RANDOM[POLYGLOT_EN_PASSANT + fileOf(epSquare)];
+
+	if (us == WHITE)
+		key ^= POLYGLOT_RANDOM[POLYGLOT_TURN];
+	return key;
+}
+
+bool OpeningBook::open(const std::string &path)
+{
+	close();
+	if (!file.open(path))
+		return false;
+	if (file.size() % BOOK_ENTRY_SIZE != 0)
+	{
+		file.close();
+		return false;
+	}
+	data = file.data();
+	count = file.size() / BOOK_ENTRY_SIZE;
+	return true;
+}
+
+void OpeningBook::close()
+{
+	file.close();
+	data = nullptr;
+	count = 0;
+}
+
+// Function to decode one big endian entry straight from the mapped file
+BookEntry OpeningBook::entry(size_t index) const
+{
+	const unsigned char *bytes = data + index * BOOK_ENTRY_SIZE;
+	auto read = [&](int offset, int size)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < size; i++)
+			value = value << 8 | bytes[offset + i];
+		return value;
+	};
+	return {read(0, 8), uint16_t(read(8, 2)), uint16_t(read(10, 2)), uint32_t(read(12, 4))};
+}
+
+std::vector<BookMove> OpeningBook::probe(const Position &position) const
+{
+	std::vector<BookMove> moves;
+	uint64_t key = polyglotKey(position);
+
+	// First entry with this key
+	size_t low = 0, high = count;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (entry(middle).key < key)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	for (size_t i = low; i < count; i++)
+	{
+		BookEntry found = entry(i);
+		if (found.key != key)
+			break;
+		Move move = decodeBookMove(position, found.move);
+		if (move != MOVE_NONE && found.weight > 0)
+			moves.push_back({move, found.weight});
+	}
+
+	std::stable_sort(moves.begin(), moves.end(), [](const BookMove &a, const BookMove &b)
+					 { return a.weight > b.weight; });
+	return moves;
+}
+
+Move OpeningBook::pick(const Position &position, std::mt19937_64 &rng) const
+{
+	std::vector<BookMove> moves = probe(position);
+	int total = 0;
+	for (const BookMove &bookMove : moves)
+		total += bookMove.weight;
+	if (total == 0)
+		return MOVE_NONE;
+
+	int ticket = std::uniform_int_distribution<int>(0, total - 1)(rng);
+	for (const BookMove &bookMove : moves)
+	{
+		ticket -= bookMove.weight;
+		if (ticket < 0)
+			return bookMove.move;
+	}
+	return moves.back().move;
+}
+
+uint16_t encodeBookMove(Move move)
+{
+	int from = moveFrom(move), to = moveTo(move);
+	if (moveFlags(move) == KING_CASTLE)
+		to = makeSquare(7, rankOf(from));
+	else if (moveFlags(move) == QUEEN_CASTLE)
+		to = makeSquare(0, rankOf(from));
+
+	// Knight, bishop, rook, queen are 1 to 4
+	int promotion = 0;
+	if (isPromotion(move))
+	{
+		PieceKind kind = promotionKind(move);
+		promotion = kind == KNIGHT ? 1 : kind == BISHOP ? 2 : kind == ROOK ? 3 : 4;
+	}
+	return uint16_t(to | from << 6 | promotion << 12);
+}
+
+Move decodeBookMove(const Position &position, uint16_t bookMove)
+{
+	static const PieceKind PROMOTIONS[5] = {QUEEN, KNIGHT, BISHOP, ROOK, QUEEN};
+	int to = bookMove & 63, from = (bookMove >> 6) & 63, promotion = (bookMove >> 12) & 7;
+	if (promotion > 4)
+		return MOVE_NONE;
+
+	// The king taking its own rook is castling
+	PieceType piece = position.pieceOn(from);
+	if (pieceKind(piece) == KING && position.pieceOn(to) == makePiece(pieceColor(piece), ROOK))
+		to = makeSquare(fileOf(to) == 7 ? 6 : 2, rankOf(from));
+
+	Move move = position.findMove(from, to, PROMOTIONS[promotion]);
+	// findMove promotes to a queen when given no piece, the entry must name it
+	if (move != MOVE_NONE && isPromotion(move) != (promotion != 0))
+		return MOVE_NONE;
+	return move;
+}
+
+// Function to write one entry big endian
+static void writeEntry(std::ofstream &file, const BookEntry &entry)
+{
+	unsigned char bytes[BOOK_ENTRY_SIZE];
+	for (int i = 0; i < 8; i++)
+		bytes[i] = (entry.key >> (56 - 8 * i)) & 0xFF;
+	bytes[8] = entry.move >> 8;
+	bytes[9] = entry.move & 0xFF;
+	bytes[10] = entry.weight >> 8;
+	bytes[11] = entry.weight & 0xFF;
+	for (int i = 0; i < 4; i++)
+		bytes[12 + i] = (entry.learn >> (24 - 8 * i)) & 0xFF;
+	file.write(reinterpret_cast<const char *>(bytes), BOOK_ENTRY_SIZE);
+}
+
+bool writeBook(const std::string &path, std::vector<BookEntry> &entries)
+{
+	std::sort(entries.begin(), entries.end(), [](const BookEntry &a, const BookEntry &b)
+			  { return a.key != b.key ? a.key < b.key : a.weight > b.weight; });
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	for (const BookEntry &entry : entries)
+		writeEntry(file, entry);
+	return bool(file);
+}
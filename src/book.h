@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+#include "position.h"
+
+// Opening book in the Polyglot .bin layout: 16 byte big endian entries (key, move, weight, learn)
+// sorted by Polyglot key, so every entry of a position sits in one run found by binary search.
+// Books made by other Polyglot tools can be read, and books made by makebook can be read by them
+struct BookEntry
+{
+	uint64_t key;
+	uint16_t move;
+	uint16_t weight;
+	uint32_t learn;
+};
+
+struct BookMove
+{
+	Move move;
+	int weight;
+};
+
+// A book file mapped into memory. Opening it reads nothing, probing touches only the pages the
+// binary search visits
+class OpeningBook
+{
+public:
+	// Returns false and stays closed when the file is missing or not a whole number of entries
+	bool open(const std::string &path);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+	size_t size() const { return count; }
+
+	// Legal book moves for position, heaviest first. Empty when out of book
+	std::vector<BookMove> probe(const Position &position) const;
+	// Book move picked at random with probability proportional to its weight, or MOVE_NONE
+	Move pick(const Position &position, std::mt19937_64 &rng) const;
+
+private:
+	BookEntry entry(size_t index) const;
+
+	MappedFile file;
+	const unsigned char *data = nullptr;
+	size_t count = 0;
+};
+
+// Polyglot move encoding: to, from and promotion piece, castling written as the king taking its rook
+uint16_t encodeBookMove(Move move);
+Move decodeBookMove(const Position &position, uint16_t bookMove);
+
+// Key of position in the Polyglot format, which the entries are sorted by. Not the search's Zobrist
+// key: Polyglot fixes its own random numbers and counts en passant only when a capture is possible
+uint64_t polyglotKey(const Position &position);
+
+// Sorts entries by key and writes them as a book file
+bool writeBook(const std::string &path, std::vector<BookEntry> &entries);
@@ -1,34 +1,50 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
 #include <iostream>
+#include <random>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "book.h"
+#include "nnue.h"
+#include "position.h"
+#include "engine.h"
+#include "gamestate.h"
+#include "glyphatlas.h"
+#include "pieceatlas.h"
+#include "tablebase.h"
+#include "tt.h"
+
 const int LOG_VECTOR_SIZE = 20;
 const int SIDE_PANEL_WIDTH = 400;
 const int BOARD_WIDTH = 1000;
 const int BOARD_HEIGHT = 1000;
-const int SCREEN_WIDTH = BOARD_WIDTH; // + SIDE_PANEL_WIDTH;
+const int SCREEN_WIDTH = BOARD_WIDTH + SIDE_PANEL_WIDTH;
 const int SCREEN_HEIGHT = BOARD_HEIGHT;
 const int BOARD_SIZE = 8;
 const int TILE_SIZE = BOARD_WIDTH / BOARD_SIZE;
-
-enum PieceType
-{
-	BLACK_PAWN = 1,
-	BLACK_ROOK = 2,
-	BLACK_KNIGHT = 3,
-	BLACK_BISHOP = 4,
-	BLACK_QUEEN = 5,
-	BLACK_KING = 6,
-	WHITE_PAWN = 7,
-	WHITE_ROOK = 8,
-	WHITE_KNIGHT = 9,
-	WHITE_BISHOP = 10,
-	WHITE_QUEEN = 11,
-	WHITE_KING = 12,
-};
+const int AI_MOVE_TIME_MS = 1000;
+const int HASH_SIZE_MB = 64;
+const std::string NNUE_FILE = "res/nnue.bin";
+const std::string BOOK_FILE = "res/book.bin";
+const std::string TABLEBASE_DIRECTORY = "res/tb";
+const int BOOK_PANEL_LINE_HEIGHT = 40;
+const int ENGINE_POLL_MS = 10;
+const int IDLE_WAIT_MS = 1000;
+const Uint32 RESIZE_SETTLE_MS = 250;
+const size_t MAX_FRAME_SAMPLES = 1 << 16;
+const SDL_Color TEXT_COLOR = {255, 255, 255, 255};
+// Sprite of each piece, indexed by piece - 1
+const std::string PIECE_FILES[PieceAtlas::PIECE_COUNT] = {
+	"res/pieces-svg/pawn-b.svg", "res/pieces-svg/rook-b.svg", "res/pieces-svg/knight-b.svg", "res/pieces-svg/bishop-b.svg",
+	"res/pieces-svg/queen-b.svg", "res/pieces-svg/king-b.svg", "res/pieces-svg/pawn-w.svg", "res/pieces-svg/rook-w.svg",
+	"res/pieces-svg/knight-w.svg", "res/pieces-svg/bishop-w.svg", "res/pieces-svg/queen-w.svg", "res/pieces-svg/king-w.svg"};
 
 // Function to initialize SDL
 bool init(SDL_Window *&window, SDL_Renderer *&renderer, TTF_Font *&font)
@@ -45,19 +61,24 @@ bool init(SDL_Window *&window, SDL_Renderer *&renderer, TTF_Font *&font)
 		return false;
 	}
 
-	window = SDL_CreateWindow("Chess Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+	window = SDL_CreateWindow("Chess Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT,
+							  SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
 	if (!window)
 	{
 		std::cerr << "Failed to create window: " << SDL_GetError() << std::endl;
 		return false;
 	}
 
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+	// Presenting waits for the display refresh, so frames never come faster than the screen shows them
+	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 	if (!renderer)
 	{
 		std::cerr << "Failed to create renderer: " << SDL_GetError() << std::endl;
 		return false;
 	}
+	// Everything is drawn in SCREEN_WIDTH x SCREEN_HEIGHT coordinates, which SDL scales to the
+	// window's pixels (mouse events included) whatever its size and the display's scaling
+	SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
 
 	font = TTF_OpenFont("res/fonts/Roboto-Regular.ttf", 32);
 	if (!font)
@@ -73,58 +94,20 @@ bool init(SDL_Window *&window, SDL_Renderer *&renderer, TTF_Font *&font)
 	return true;
 }
 
-// Function to render text using SDL_ttf
-void renderText(SDL_Renderer *renderer, TTF_Font *font, const std::string &text, int x, int y, bool centeredX = true, bool centeredY = true)
-{
-	if (!font)
-	{
-		std::cerr << "Error: Font is NULL. Cannot render text." << std::endl;
-		return;
-	}
-
-	SDL_Color white = {255, 255, 255, 255}; // Text color
-	SDL_Surface *surface = TTF_RenderText_Solid(font, text.c_str(), white);
-	if (!surface)
-	{
-		std::cerr << "Failed to create text surface: " << TTF_GetError() << std::endl;
-		return;
-	}
-
-	SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-	if (!texture)
-	{
-		std::cerr << "Failed to create text texture: " << SDL_GetError() << std::endl;
-		SDL_FreeSurface(surface);
-		return;
-	}
-
-	int textWidth = surface->w;
-	int textHeight = surface->h;
-	SDL_FreeSurface(surface);
-
-	SDL_Rect destRect = {x, y, textWidth, textHeight};
-	if (centeredX)
-		destRect.x -= textWidth / 2;
-	if (centeredY)
-		destRect.y -= textHeight / 2;
-
-	SDL_RenderCopy(renderer, texture, nullptr, &destRect);
-	SDL_DestroyTexture(texture);
-}
-
 // Function to render the game menu
-void renderMenu(SDL_Renderer *renderer, TTF_Font *font)
+void renderMenu(SDL_Renderer *renderer, GlyphAtlas &text)
 {
 	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 128); // Black with 50% opacity
 	SDL_Rect menuBackground = {100, 100, SCREEN_WIDTH - 200, SCREEN_HEIGHT - 200};
 	SDL_RenderFillRect(renderer, &menuBackground);
 
 	// Render menu options
-	renderText(renderer, font, "Resume Game", SCREEN_WIDTH / 2, 200);
-	renderText(renderer, font, "Restart Game", SCREEN_WIDTH / 2, 250);
-	renderText(renderer, font, "Settings", SCREEN_WIDTH / 2, 300);
-	renderText(renderer, font, "Help", SCREEN_WIDTH / 2, 350);
-	renderText(renderer, font, "Exit", SCREEN_WIDTH / 2, 400);
+	text.add("Resume Game", SCREEN_WIDTH / 2, 200, TEXT_COLOR, true, true);
+	text.add("Restart Game", SCREEN_WIDTH / 2, 250, TEXT_COLOR, true, true);
+	text.add("Settings", SCREEN_WIDTH / 2, 300, TEXT_COLOR, true, true);
+	text.add("Help", SCREEN_WIDTH / 2, 350, TEXT_COLOR, true, true);
+	text.add("Exit", SCREEN_WIDTH / 2, 400, TEXT_COLOR, true, true);
+	text.flush(renderer);
 }
 
 // Function to draw the chessboard
@@ -156,95 +139,31 @@ bool isPointInRect(int x, int y, SDL_Rect rect)
 	return (x >= rect.x && x <= rect.x + rect.w && y >= rect.y && y <= rect.y + rect.h);
 }
 
-// Function to load a texture
-SDL_Texture *loadTexture(const std::string &file, SDL_Renderer *ren)
+// Function to check whether a point is on the board. Clicks in the bars SDL adds around the scene
+// of a resized window come with coordinates below 0 or past the screen
+bool isPointOnBoard(int x, int y)
 {
-	SDL_Texture *texture = IMG_LoadTexture(ren, file.c_str());
-	if (texture == nullptr)
-	{
-		std::cerr << "LoadTexture Error: " << IMG_GetError() << std::endl;
-	}
-	return texture;
+	return x >= 0 && x < BOARD_WIDTH && y >= 0 && y < BOARD_HEIGHT;
 }
 
-void renderPiecesInBoard(SDL_Renderer *renderer, SDL_Texture *pieces[12], int board[8][8])
+// Function to draw chess notation on the board borders, each label in the color of the other tile shade
+void renderBoardNotation(SDL_Renderer *renderer, GlyphAtlas &text)
 {
-	for (int i = 0; i < 8; i++)
-	{
-		for (int j = 0; j < 8; j++)
-		{
-			if (board[i][j] != 0)
-			{
-				SDL_Rect rect = {j * TILE_SIZE, i * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-				SDL_RenderCopy(renderer, pieces[board[i][j] - 1], NULL, &rect);
-			}
-		}
-	}
-}
-
-// Function to draw chess notation on the board borders
-void renderBoardNotation(SDL_Renderer *renderer, TTF_Font *font)
-{
-	// TODO: for better performance, we can add a notation flag on the renderBoard function and iterate only once
-	// while rendering the board and the notation
-	SDL_Color color;
+	const SDL_Color dark = {118, 150, 86, 255};
+	const SDL_Color light = {238, 238, 210, 255};
 
 	// Draw rank numbers (1-8) along the left side
 	for (int row = 0; row < 8; ++row)
 	{
-		std::string rank = std::to_string(8 - row);
-		if (row % 2 == 0)
-		{
-			color = {118, 150, 86, 255};
-		}
-		else
-		{
-			color = {238, 238, 210, 255};
-		}
-		// SDL_Surface* textSurface = TTF_RenderText_Solid(font, rank.c_str(), white);
-		SDL_Surface *textSurface = TTF_RenderText_Blended(font, rank.c_str(), color);
-		SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-
-		// Get text dimensions
-		int textWidth, textHeight;
-		SDL_QueryTexture(textTexture, nullptr, nullptr, &textWidth, &textHeight);
-
-		// Position text
-		// SDL_Rect destRect = {5, row * TILE_SIZE + TILE_SIZE / 2 - textHeight / 2, textWidth, textHeight};
-		SDL_Rect destRect = {5, row * TILE_SIZE + 5, textWidth, textHeight};
-		SDL_RenderCopy(renderer, textTexture, nullptr, &destRect);
-
-		SDL_FreeSurface(textSurface);
-		SDL_DestroyTexture(textTexture);
+		text.add(std::to_string(8 - row), 5, row * TILE_SIZE + 5, row % 2 == 0 ? dark : light);
 	}
 
 	// Draw file letters (a-h) along the bottom
 	for (int col = 0; col < 8; ++col)
 	{
-		char file = 'a' + col;
-		if (col % 2 == 0)
-		{
-			color = {238, 238, 210, 255};
-		}
-		else
-		{
-			color = {118, 150, 86, 255};
-		}
-		std::string fileStr(1, file);
-		SDL_Surface *textSurface = TTF_RenderText_Solid(font, fileStr.c_str(), color);
-		SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-
-		// Get text dimensions
-		int textWidth, textHeight;
-		SDL_QueryTexture(textTexture, nullptr, nullptr, &textWidth, &textHeight);
-
-		// Position text
-		SDL_Rect destRect = {col * TILE_SIZE + 5, SCREEN_HEIGHT - textHeight - 5, textWidth, textHeight};
-		SDL_RenderCopy(renderer, textTexture, nullptr, &destRect);
-
-		SDL_FreeSurface(textSurface);
-		SDL_DestroyTexture(textTexture);
+		text.add(std::string(1, char('a' + col)), col * TILE_SIZE + 5, SCREEN_HEIGHT - text.lineHeight() - 5, col % 2 == 0 ? light : dark);
 	}
+	text.flush(renderer);
 }
 
 // Function to log selected pieces on the board [when dragging]
@@ -295,231 +214,384 @@ void logSelectedPiece(int pieceSelected)
 	}
 }
 
-void renderHoveredTileBorder(SDL_Renderer *renderer, int hoveredRow, int hoveredCol, bool isDragging)
+// Overlays a square can show over its tile, drawn in this order below the piece
+enum SquareOverlay
 {
-	// std::cout << "is dragging: (" << static_cast<bool>(isDragging) << ")" << std::endl;
-	if (hoveredRow >= 0 && hoveredCol >= 0 /*&& hoveredRow < 8 && hoveredCol < 8*/ && isDragging)
+	OVERLAY_SELECTED = 1, // tile the piece was picked up from, or the last move came from
+	OVERLAY_HOVERED = 2,  // tile under a dragged piece
+	OVERLAY_DRAGGED = 4,  // tile the last move went to
+	OVERLAY_MARKED = 8,	  // marked red with a right click
+	OVERLAY_HANGING = 16  // piece either side could lose material on, with 'h'
+};
+
+// What a square shows: its piece (EMPTY while it is being dragged) and overlays. The scene is
+// only redrawn on the squares whose look changed since the frame before
+struct SquareLook
+{
+	int piece = -1;
+	int overlays = 0;
+
+	bool operator==(const SquareLook &other) const { return piece == other.piece && overlays == other.overlays; }
+};
+
+// Layers a frame is drawn in, one batch each. The tiles of the changed squares are copied back
+// from the board layer and their pieces and highlights drawn over them in the scene texture, which
+// is then copied to the screen with the dragged piece on top
+enum RenderLayer
+{
+	LAYER_BOARD,   // changed tiles, the side panel when it changed and the copy of the scene
+	LAYER_PIECES,  // pieces and highlights of the changed squares
+	LAYER_DRAGGED, // the piece under the mouse
+	LAYER_COUNT
+};
+
+// Draw calls per layer and pixels filled by the frames drawn, next to the pixels drawing everything
+// every frame would have filled, how long frames took and how much CPU the loop used while idle,
+// printed on exit
+struct RenderStats
+{
+	uint64_t frames = 0;
+	uint64_t layerDrawCalls[LAYER_COUNT] = {};
+	uint64_t pixels = 0;
+	uint64_t fullPixels = 0;
+
+	std::vector<double> frameMs; // the last MAX_FRAME_SAMPLES frames, from the first draw call to the present
+	uint64_t frameCount = 0;
+	double idleSeconds = 0;		 // loop iterations that drew nothing with no search running
+	double idleCpuSeconds = 0;
+};
+
+void recordFrameTime(RenderStats &stats, double ms)
+{
+	if (stats.frameMs.size() < MAX_FRAME_SAMPLES)
+		stats.frameMs.push_back(ms);
+	else
+		stats.frameMs[stats.frameCount % MAX_FRAME_SAMPLES] = ms;
+	stats.frameCount++;
+}
+
+// Function to print the rendering counters gathered over the session
+void printRenderStats(RenderStats &stats)
+{
+	if (stats.frames > 0)
 	{
-		SDL_Rect rect = {hoveredCol * TILE_SIZE, hoveredRow * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-		SDL_SetRenderDrawColor(renderer, 255, 255, 255, 150);
-		for (int i = 0; i < 5; ++i) // Increase the number of iterations for a wider border
-		{
-			SDL_RenderDrawRect(renderer, &rect);
-			rect.x += 1;
-			rect.y += 1;
-			rect.w -= 2;
-			rect.h -= 2;
-		}
+		double screen = double(SCREEN_WIDTH) * SCREEN_HEIGHT * stats.frames;
+		std::cout << "Board: " << stats.frames << " frames, draw calls per frame: board layer " << double(stats.layerDrawCalls[LAYER_BOARD]) / stats.frames
+				  << ", pieces layer " << double(stats.layerDrawCalls[LAYER_PIECES]) / stats.frames << ", dragged piece "
+				  << double(stats.layerDrawCalls[LAYER_DRAGGED]) / stats.frames << std::endl;
+		std::cout << "Board: " << 100 * stats.pixels / screen << "% of the screen filled per frame (redrawing everything: " << 100 * stats.fullPixels / screen << "%)"
+				  << std::endl;
+	}
+	if (!stats.frameMs.empty())
+	{
+		std::vector<double> &times = stats.frameMs;
+		std::sort(times.begin(), times.end());
+		auto percentile = [&](double p)
+		{ return times[std::min(times.size() - 1, size_t(p * times.size()))]; };
+		std::cout << "Frame time: " << stats.frameCount << " frames, p50 " << percentile(0.5) << " ms, p95 " << percentile(0.95) << " ms, p99 " << percentile(0.99)
+				  << " ms, max " << times.back() << " ms" << std::endl;
 	}
+	if (stats.idleSeconds > 0)
+		std::cout << "Idle: " << stats.idleSeconds << " s, CPU use " << 100 * stats.idleCpuSeconds / stats.idleSeconds << "%" << std::endl;
 }
 
-void renderHighlightSelectedPieceTile(
-	SDL_Renderer *renderer, bool isPieceSelected, int pieceRowSelected, int pieceColSelected)
+// Function to render the parts of the board that never change (tiles and coordinates) once into a
+// texture the tiles of changed squares are copied back from
+SDL_Texture *createBoardLayer(SDL_Renderer *renderer, GlyphAtlas &text)
 {
-	SDL_Rect rect;
-	if (pieceColSelected >= 0 && pieceRowSelected >= 0)
+	SDL_Texture *layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, BOARD_WIDTH, BOARD_HEIGHT);
+	if (!layer)
 	{
-		// Highlight selected piece tile
-		rect = {pieceColSelected * TILE_SIZE, pieceRowSelected * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-		SDL_SetRenderDrawColor(renderer, 185, 202, 66, 128); // Green with 50% opacity
-		SDL_RenderFillRect(renderer, &rect);
+		std::cerr << "Failed to create the board layer: " << SDL_GetError() << std::endl;
+		return nullptr;
 	}
-	// Highlight selected piece tile
-	// if (isPieceSelected)
-	// {
-	// 	rect = {pieceColSelected * TILE_SIZE, pieceRowSelected * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-	// 	SDL_SetRenderDrawColor(renderer, 185, 202, 66, 128); // Green with 50% opacity
-	// 	SDL_RenderFillRect(renderer, &rect);
-	// }
+	SDL_SetTextureBlendMode(layer, SDL_BLENDMODE_NONE);
+	SDL_SetRenderTarget(renderer, layer);
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+	renderBoard(renderer);
+	renderBoardNotation(renderer, text);
+	SDL_SetRenderTarget(renderer, nullptr);
+	return layer;
 }
 
-void renderHighlightDraggedPieceTile(
-	SDL_Renderer *renderer, bool isPieceSelected, int pieceRowDragged, int pieceColDragged)
+// Function to create the texture the scene is composed in, with as many pixels as it covers on the
+// screen so the sprites drawn into it stay sharp. scaleX and scaleY map screen coordinates to them
+SDL_Texture *createScene(SDL_Renderer *renderer, float &scaleX, float &scaleY)
 {
-	SDL_Rect rect;
-	if (pieceColDragged >= 0 && pieceRowDragged >= 0 && isPieceSelected)
+	SDL_RenderGetScale(renderer, &scaleX, &scaleY);
+	int width = std::max(1, int(SCREEN_WIDTH * scaleX + 0.5f));
+	int height = std::max(1, int(SCREEN_HEIGHT * scaleY + 0.5f));
+	SDL_Texture *scene = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, width, height);
+	if (!scene)
 	{
-		// Highlight dragged piece tile
-		rect = {pieceColDragged * TILE_SIZE, pieceRowDragged * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-		SDL_SetRenderDrawColor(renderer, 246, 246, 130, 128); // Yellow with 50% opacity
-		SDL_RenderFillRect(renderer, &rect);
-		//std::cout << "Piece dragged at: (Row: " << pieceRowDragged << ", Col: " << pieceColDragged << ")" << std::endl;
+		std::cerr << "Failed to create the scene: " << SDL_GetError() << std::endl;
+		return nullptr;
 	}
+	SDL_SetTextureBlendMode(scene, SDL_BLENDMODE_NONE);
+	return scene;
 }
 
-void renderHighlightRedTile(
-	SDL_Renderer *renderer, bool isPieceSelected, std::vector<std::pair<int, int>> selectedRedTiles)
+// Function to copy tiles of the board layer back over whatever was drawn on them, in one draw call
+void restoreTiles(SDL_Renderer *renderer, SDL_Texture *boardLayer, const std::vector<SDL_Rect> &tiles)
 {
-	SDL_Rect rect;
-	// Highlight selected piece tile	
-	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-	
-	for (const auto &tile : selectedRedTiles)
+	if (tiles.empty())
+		return;
+	std::vector<SDL_Vertex> vertices;
+	std::vector<int> indices;
+	vertices.reserve(tiles.size() * 4);
+	indices.reserve(tiles.size() * 6);
+	const SDL_Color white = {255, 255, 255, 255};
+	for (const SDL_Rect &tile : tiles)
 	{
-		// std::cout << "Total tiles: " << selectedRedTiles.size() << std::endl;
-		rect = {tile.first * TILE_SIZE, tile.second * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-		SDL_SetRenderDrawColor(renderer, 255, 0, 0, 128); // Red with 50% opacity
-		SDL_RenderFillRect(renderer, &rect);
+		float left = float(tile.x), top = float(tile.y);
+		float right = left + tile.w, bottom = top + tile.h;
+		float s0 = left / BOARD_WIDTH, t0 = top / BOARD_HEIGHT;
+		float s1 = right / BOARD_WIDTH, t1 = bottom / BOARD_HEIGHT;
+
+		int first = int(vertices.size());
+		vertices.push_back({{left, top}, white, {s0, t0}});
+		vertices.push_back({{right, top}, white, {s1, t0}});
+		vertices.push_back({{left, bottom}, white, {s0, t1}});
+		vertices.push_back({{right, bottom}, white, {s1, t1}});
+		for (int corner : {0, 1, 2, 2, 1, 3})
+			indices.push_back(first + corner);
 	}
-	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+	SDL_RenderGeometry(renderer, boardLayer, vertices.data(), int(vertices.size()), indices.data(), int(indices.size()));
 }
 
-// Function to validate if a pawn move is valid
-bool IsValidPawnMove(int board[8][8], int piece, int selectedRow, int selectedCol, int draggedRow, int draggedCol)
+// Function to find what every square shows this frame, indexed by row * 8 + col
+void computeSquareLooks(SquareLook looks[64], const Position &position, bool pieceSelected, bool dragging, int pieceRowSelected, int pieceColSelected,
+						int pieceRowDragged, int pieceColDragged, int hoveredRow, int hoveredCol, const std::vector<std::pair<int, int>> &selectedRedTiles, bool isHangingShown)
 {
-	int target = board[draggedRow][draggedCol];
-
-	if (piece == 1) // Black Pawn
+	Bitboard hanging = isHangingShown ? position.hangingPieces(WHITE) | position.hangingPieces(BLACK) : 0;
+	for (int row = 0; row < 8; row++)
 	{
-		std::cout << "Selected black pawn"  << std::endl;
-		// Move forward
-		if (selectedCol == draggedCol && selectedRow + 1 == draggedRow && target == 0)
-			return true;
-
-		// Double move from starting position
-		if (selectedCol == draggedCol && selectedRow == 1 && selectedRow + 2 == draggedRow && target == 0 && board[selectedRow + 1][selectedCol] == 0)
-			return true;
-
-		// Capture
-		if (abs(selectedCol - draggedCol) == 1 && selectedRow + 1 == draggedRow && target > 6)
-			return true;
+		for (int col = 0; col < 8; col++)
+		{
+			int sq = squareFromTile(row, col);
+			bool isSelected = row == pieceRowSelected && col == pieceColSelected;
+			SquareLook &look = looks[row * 8 + col];
+			look.piece = dragging && isSelected ? EMPTY : position.pieceOn(sq);
+			look.overlays = 0;
+			if (isSelected)
+				look.overlays |= OVERLAY_SELECTED;
+			if (dragging && row == hoveredRow && col == hoveredCol)
+				look.overlays |= OVERLAY_HOVERED;
+			if (pieceSelected && row == pieceRowDragged && col == pieceColDragged)
+				look.overlays |= OVERLAY_DRAGGED;
+			if (std::find(selectedRedTiles.begin(), selectedRedTiles.end(), std::make_pair(col, row)) != selectedRedTiles.end())
+				look.overlays |= OVERLAY_MARKED;
+			if (hanging & squareBB(sq))
+				look.overlays |= OVERLAY_HANGING;
+		}
 	}
-	else if (piece == 7) // White Pawn
+}
+
+// Width of the border around the tile under a dragged piece
+const int HOVER_BORDER_WIDTH = 5;
+
+// Function to queue the overlays and piece of one square: the selected and last move tiles in
+// green and yellow, a white border under a dragged piece, marked and hanging pieces tinted red
+void addSquare(PieceAtlas &pieces, int row, int col, const SquareLook &look)
+{
+	SDL_Rect tile = {col * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE};
+	if (look.overlays & OVERLAY_SELECTED)
+		pieces.addRect(tile, {185, 202, 66, 255});
+	if (look.overlays & OVERLAY_HOVERED)
 	{
-		std::cout << "Selected white pawn"  << std::endl;
-		// Move forward
-		if (selectedCol == draggedCol && selectedRow - 1 == draggedRow && target == 0)
-			return true;
-
-		// Double move from starting position
-		if (selectedCol == draggedCol && selectedRow == 6 && selectedRow - 2 == draggedRow && target == 0 && board[selectedRow - 1][selectedCol] == 0)
-			return true;
-
-		// Capture
-		if (abs(selectedCol - draggedCol) == 1 && selectedRow - 1 == draggedRow && target > 0 && target <= 6)
-			return true;
+		const SDL_Color border = {255, 255, 255, 255};
+		const int width = HOVER_BORDER_WIDTH;
+		pieces.addRect({tile.x, tile.y, TILE_SIZE, width}, border);
+		pieces.addRect({tile.x, tile.y + TILE_SIZE - width, TILE_SIZE, width}, border);
+		pieces.addRect({tile.x, tile.y + width, width, TILE_SIZE - 2 * width}, border);
+		pieces.addRect({tile.x + TILE_SIZE - width, tile.y + width, width, TILE_SIZE - 2 * width}, border);
 	}
+	if (look.overlays & OVERLAY_DRAGGED)
+		pieces.addRect(tile, {246, 246, 130, 255});
+	if (look.overlays & OVERLAY_MARKED)
+		pieces.addRect(tile, {255, 0, 0, 128});
+	if (look.overlays & OVERLAY_HANGING)
+		pieces.addRect(tile, {255, 0, 0, 128});
+
+	if (look.piece != EMPTY)
+		pieces.addPiece(look.piece, tile);
+}
 
-	return false;
+// Function to count the pixels redrawing a square fills: its tile, each overlay and its piece
+int squarePixels(const SquareLook &look)
+{
+	int fills = 1 + (look.piece != EMPTY ? 1 : 0);
+	fills += (look.overlays & OVERLAY_SELECTED ? 1 : 0) + (look.overlays & OVERLAY_DRAGGED ? 1 : 0);
+	fills += (look.overlays & OVERLAY_MARKED ? 1 : 0) + (look.overlays & OVERLAY_HANGING ? 1 : 0);
+	int border = look.overlays & OVERLAY_HOVERED ? 4 * HOVER_BORDER_WIDTH * (TILE_SIZE - HOVER_BORDER_WIDTH) : 0;
+	return fills * TILE_SIZE * TILE_SIZE + border;
 }
 
-// Function to validate if a move is valid
-bool isValidMove(int board[8][8], int piece, int selectedRow, int selectedCol, int draggedRow, int draggedCol)
+// Function to find the legal move matching a drag from the selected tile to the dropped tile
+Move findLegalMove(const Position &position, int selectedRow, int selectedCol, int draggedRow, int draggedCol)
 {
-	
 	// Ensure the move is within bounds
 	if (selectedRow < 0 || selectedRow >= 8 || selectedCol < 0 || selectedCol >= 8 || draggedRow < 0 || draggedRow >= 8 || draggedCol < 0 || draggedCol >= 8)
 	{
-		return false;
+		return MOVE_NONE;
 	}
 
-	// Ensure the move is not to the same position
-	if (selectedRow == draggedRow && selectedCol == draggedCol)
+	// Pawns dropped on the last rank are promoted to a queen
+	return position.findMove(squareFromTile(selectedRow, selectedCol), squareFromTile(draggedRow, draggedCol), QUEEN);
+}
+
+// Function to print check, checkmate or stalemate for the position on the board
+void logGameStatus(const Position &position)
+{
+	MoveList replies;
+	position.generateLegalMoves(replies);
+	if (replies.size() == 0)
 	{
-		return false;
+		std::cout << (position.inCheck() ? "Checkmate" : "Stalemate") << std::endl;
 	}
+	else if (position.inCheck())
+	{
+		std::cout << "Check" << std::endl;
+	}
+}
+
+// Function to play a move on the board, keeping it in the game so it can be taken back
+void playMove(GameState &game, Move move)
+{
+	game.makeMove(move);
+	logGameStatus(game.position());
+}
 
-	
-	// Ensure the move is not to the same color piece
-	// if (board[selectedRow][selectedCol] > 6 && board[draggedRow][draggedCol] > 6)
-	// {
-	// 	return false;
-	// }
-	// if (board[selectedRow][selectedCol] < 7 && board[draggedRow][draggedCol] < 7)
-	// {
-	// 	return false;
-	// }
-
-	//TODO: move below validation to the piece validation function, there are instances 
-	//where piece can move if the target contains a piece of the same color 
-	// // Ensure the move is not to an invalid tile (tile with piece in it) 
-	// if (board[draggedRow][draggedCol] != 0)
-	// {
-	// 	return false;
-	// }
-	std::cout << "passed all validation before switch" << piece << std::endl;
-	// Determine piece type and validate move accordingly
-	switch (piece)
+// Function to take back a move (or play an undone one again). Against the AI it keeps stepping
+// until it is the human's turn, so the AI does not answer straight away
+void stepThroughGame(GameState &game, bool back, bool isAIEnabled, Color aiColor)
+{
+	do
 	{
-		case 1: // Black Pawn
-		case 7: // White Pawn
-			return IsValidPawnMove(board, piece, selectedRow, selectedCol, draggedRow, draggedCol);
-			//break;
-	// case 7: // White Pawn
-	//     if (startY == endY && endX - startX == 1 && target == 0)
-	//         return true; // Move forward
-	//     if (startY == endY && startX == 1 && endX - startX == 2 && target == 0)
-	//         return true; // Double move from starting position
-	//     if (abs(startY - endY) == 1 && endX - startX == 1 && target <= 6 && target != 0)
-	//         return true; // Capture
-	//     break;
-	// case 2: // Black Rook
-	// case 8: // White Rook
-	//     if (startX == endX || startY == endY)
-	//         return true; // Move in straight lines
-	//     break;
-	// case 3: // Black Knight
-	// case 9: // White Knight
-	//     if ((abs(startX - endX) == 2 && abs(startY - endY) == 1) || (abs(startX - endX) == 1 && abs(startY - endY) == 2))
-	//         return true; // L-shaped move
-	//     break;
-	// case 4: // Black Bishop
-	// case 10: // White Bishop
-	//     if (abs(startX - endX) == abs(startY - endY))
-	//         return true; // Move diagonally
-	//     break;
-	// case 5: // Black Queen
-	// case 11: // White Queen
-	//     if (startX == endX || startY == endY || abs(startX - endX) == abs(startY - endY))
-	//         return true; // Move like rook or bishop
-	//     break;
-	// case 6: // Black King
-	// case 12: // White King
-	//     if (abs(startX - endX) <= 1 && abs(startY - endY) <= 1)
-	//         return true; // Move one square in any direction
-	//     break;
-	default:
-		return false;
+		if (back ? !game.canUndo() : !game.canRedo())
+			break;
+		if (back)
+			game.undo();
+		else
+			game.redo();
+	} while (isAIEnabled && game.position().sideToMove() == aiColor);
+
+	std::cout << (back ? "Undo" : "Redo") << ", " << (game.position().sideToMove() == WHITE ? "white" : "black") << " to move" << std::endl;
+	logGameStatus(game.position());
+}
+
+// Function to drop the AI's running search or ponder search when the position it is for goes away
+void stopAI(Engine &engine, uint32_t &aiSearchId, uint32_t &ponderSearchId)
+{
+	if (aiSearchId != 0 || ponderSearchId != 0)
+	{
+		engine.stop();
+		aiSearchId = 0;
+		ponderSearchId = 0;
 	}
+}
 
-	return false;
+// Function to let the engine thread start searching for the AI's reply, returns the search id to wait for
+uint32_t startAISearch(Engine &engine, const GameState &game)
+{
+	SearchLimits limits;
+	limits.moveTime = AI_MOVE_TIME_MS;
+	engine.setPosition(game.position(), game.history());
+	return engine.go(limits);
 }
 
-// Function to render a inside centered circle in a tile
-void renderCircleInsideTile(SDL_Renderer *renderer, std::vector<std::pair<int, int>> tiles = std::vector<std::pair<int, int>>())
+// Function to start thinking on the human's time about the position after the reply the AI expects
+uint32_t startPondering(Engine &engine, const GameState &game, Move expectedReply)
 {
-	try
+	GameState expected = game;
+	expected.makeMove(expectedReply);
+
+	SearchLimits limits;
+	limits.moveTime = AI_MOVE_TIME_MS;
+	engine.setPosition(expected.position(), expected.history());
+	return engine.go(limits, true);
+}
+
+// Function to describe the book moves of a position for the side panel: the move and the share of
+// the book's weight it has, which is how often the AI picks it
+std::vector<std::string> describeBookMoves(const Position &position, const std::vector<BookMove> &bookMoves)
+{
+	int total = 0;
+	for (const BookMove &bookMove : bookMoves)
+		total += bookMove.weight;
+
+	std::vector<std::string> lines;
+	for (const BookMove &bookMove : bookMoves)
+		lines.push_back(moveToSan(position, bookMove.move) + "  " + std::to_string((bookMove.weight * 100 + total / 2) / total) + "%");
+	return lines;
+}
+
+// Function to render the side panel listing the book moves of the position on the board
+void renderBookPanel(SDL_Renderer *renderer, GlyphAtlas &text, bool isBookOpen, const std::vector<std::string> &bookLines)
+{
+	SDL_Rect sidePanel = {BOARD_WIDTH, 0, SIDE_PANEL_WIDTH, SCREEN_HEIGHT};
+	SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255); // Dark grey background
+	SDL_RenderFillRect(renderer, &sidePanel);
+
+	int x = BOARD_WIDTH + 20;
+	int y = 20;
+	text.add("Opening book", x, y, TEXT_COLOR);
+	y += BOOK_PANEL_LINE_HEIGHT * 3 / 2;
+
+	if (!isBookOpen)
+		text.add("No book loaded", x, y, TEXT_COLOR);
+	else if (bookLines.empty())
+		text.add("Out of book", x, y, TEXT_COLOR);
+	else
 	{
-		// Render the circle inside the tile
-
-		// tiles = std::vector<std::pair<int,int>>();
-		//  tiles.push_back(std::make_pair(2, 3));
-		//  tiles.push_back(std::make_pair(2, 4));
-		//  tiles.push_back(std::make_pair(2, 5));
-
-		SDL_Rect rect = {2 * TILE_SIZE, 3 * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-		// SDL_Rect rect = {tile.first * TILE_SIZE, tile.second * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-		SDL_SetRenderDrawColor(renderer, 255, 0, 0, 128); // Red with 50% opacity
-		SDL_RenderFillRect(renderer, &rect);
-
-		// // Render the circle inside the tile
-		// for (const auto &tile : tiles)
-		// {
-		// 	SDL_Rect rect = {2 * TILE_SIZE, 3 * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-		// 	// SDL_Rect rect = {tile.first * TILE_SIZE, tile.second * TILE_SIZE, TILE_SIZE, TILE_SIZE};
-		// 	SDL_SetRenderDrawColor(renderer, 255, 0, 0, 128); // Red with 50% opacity
-		// 	SDL_RenderFillRect(renderer, &rect);
-		// }
+		for (const std::string &line : bookLines)
+		{
+			if (y + BOOK_PANEL_LINE_HEIGHT > SCREEN_HEIGHT)
+				break;
+			text.add(line, x, y, TEXT_COLOR);
+			y += BOOK_PANEL_LINE_HEIGHT;
+		}
 	}
-	catch (const std::exception &e)
+	text.flush(renderer);
+}
+
+// Function to find the size in pixels a tile covers on the screen, which the piece sprites are
+// rasterized at so they stay sharp when the window is scaled
+int pieceSpriteSize(SDL_Renderer *renderer)
+{
+	float scaleX = 1, scaleY = 1;
+	SDL_RenderGetScale(renderer, &scaleX, &scaleY);
+	return std::max(1, int(TILE_SIZE * std::max(scaleX, scaleY) + 0.5f));
+}
+
+// Function to rebuild the piece atlas at size and report what it took
+void buildPieces(SDL_Renderer *renderer, PieceAtlas &pieces, int size)
+{
+	if (!pieces.build(renderer, PIECE_FILES, size))
 	{
-		std::cerr << e.what() << '\n';
-	}	
+		std::cerr << "Pieces will not be shown" << std::endl;
+		return;
+	}
+	const PieceAtlas::BuildTimes &times = pieces.buildTimes();
+	std::cout << "Pieces: " << size << " px in " << times.totalMs << " ms on " << times.threads << " thread(s), " << times.cacheHits << " of "
+			  << PieceAtlas::PIECE_COUNT << " from the cache (read " << times.readMs << " ms, rasterize " << times.rasterizeMs << " ms, cache "
+			  << times.cacheMs << " ms, upload " << times.uploadMs << " ms)" << std::endl;
+}
+
+// Function to print how long a startup phase took and start timing the next one
+void logStartupPhase(const char *phase, std::chrono::steady_clock::time_point &since)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::cout << "Startup: " << phase << " " << std::chrono::duration<double, std::milli>(now - since).count() << " ms" << std::endl;
+	since = now;
 }
 
 // Main function
 int main(int argc, char *argv[])
 {
+	std::chrono::steady_clock::time_point startupStart = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point phaseStart = startupStart;
+
 	SDL_Window *window = nullptr;
 	SDL_Renderer *renderer = nullptr;
 	TTF_Font *font = nullptr;
@@ -530,30 +602,113 @@ int main(int argc, char *argv[])
 	{
 		return -1;
 	}
+	logStartupPhase("window and renderer", phaseStart);
+
+	// All text is drawn from one texture holding the font's glyphs, made here once
+	GlyphAtlas text;
+	if (!text.build(renderer, font))
+		std::cerr << "Text will not be shown" << std::endl;
+	logStartupPhase("glyph atlas", phaseStart);
+
+	// The board is composed in scene, which lives across frames: each frame redraws only the squares
+	// that changed (copying their tile back from boardLayer) and then copies scene to the screen
+	SDL_Texture *boardLayer = createBoardLayer(renderer, text);
+	float sceneScaleX = 1, sceneScaleY = 1;
+	SDL_Texture *scene = createScene(renderer, sceneScaleX, sceneScaleY);
+	if (!boardLayer || !scene)
+		return -1;
+	SquareLook drawnLooks[64];
+	bool isSceneValid = false;
+	RenderStats stats;
+	logStartupPhase("board layer", phaseStart);
+
+	// Every piece comes from one texture, rasterized at the size a tile covers on the screen. The
+	// sprites are kept in the user's preferences directory so the next start skips the SVG parsing
+	PieceAtlas pieces;
+	if (char *prefPath = SDL_GetPrefPath("Chess", "Chess"))
+	{
+		pieces.setCacheDirectory(prefPath);
+		SDL_free(prefPath);
+	}
+	buildPieces(renderer, pieces, pieceSpriteSize(renderer));
+	logStartupPhase("pieces", phaseStart);
+
+	// --threads N sets the number of search threads, all hardware threads by default.
+	// --nnue FILE picks the evaluation network, NNUE_FILE is used when it exists.
+	// --book FILE picks the opening book, BOOK_FILE is used when it exists.
+	// --tb DIRECTORY picks the endgame tablebases built by tbgen, TABLEBASE_DIRECTORY by default.
+	// --fen FEN starts the game from that position instead of the initial one
+	int searchThreads = std::max(1, int(std::thread::hardware_concurrency()));
+	std::string networkFile = NNUE_FILE;
+	std::string bookFile = BOOK_FILE;
+	std::string tablebaseDirectory = TABLEBASE_DIRECTORY;
+	std::string startFen = START_FEN;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (std::string(argv[i]) == "--threads")
+			searchThreads = std::atoi(argv[i + 1]);
+		else if (std::string(argv[i]) == "--nnue")
+			networkFile = argv[i + 1];
+		else if (std::string(argv[i]) == "--book")
+			bookFile = argv[i + 1];
+		else if (std::string(argv[i]) == "--tb")
+			tablebaseDirectory = argv[i + 1];
+		else if (std::string(argv[i]) == "--fen")
+			startFen = argv[i + 1];
+	}
 
-	SDL_Texture *pieces[12];
-	pieces[0] = loadTexture("res/pieces-svg/pawn-b.svg", renderer);
-	pieces[1] = loadTexture("res/pieces-svg/rook-b.svg", renderer);
-	pieces[2] = loadTexture("res/pieces-svg/knight-b.svg", renderer);
-	pieces[3] = loadTexture("res/pieces-svg/bishop-b.svg", renderer);
-	pieces[4] = loadTexture("res/pieces-svg/queen-b.svg", renderer);
-	pieces[5] = loadTexture("res/pieces-svg/king-b.svg", renderer);
-	pieces[6] = loadTexture("res/pieces-svg/pawn-w.svg", renderer);
-	pieces[7] = loadTexture("res/pieces-svg/rook-w.svg", renderer);
-	pieces[8] = loadTexture("res/pieces-svg/knight-w.svg", renderer);
-	pieces[9] = loadTexture("res/pieces-svg/bishop-w.svg", renderer);
-	pieces[10] = loadTexture("res/pieces-svg/queen-w.svg", renderer);
-	pieces[11] = loadTexture("res/pieces-svg/king-w.svg", renderer);
-
-	int board[8][8] = {
-		{2, 3, 4, 5, 6, 4, 3, 2},
-		{1, 1, 1, 1, 1, 1, 1, 1},
-		{0, 0, 0, 0, 0, 0, 0, 0},
-		{0, 0, 0, 0, 0, 0, 0, 0},
-		{0, 0, 0, 0, 0, 0, 0, 0},
-		{0, 0, 0, 0, 0, 0, 0, 0},
-		{7, 7, 7, 7, 7, 7, 7, 7},
-		{8, 9, 10, 11, 12, 10, 9, 8}};
+	if (NNUE.load(networkFile))
+		std::cout << "Loaded network " << networkFile << " (" << NNUE.simdName() << ")" << std::endl;
+	else if (networkFile != NNUE_FILE)
+		std::cerr << "Could not load network " << networkFile << ", using the handcrafted evaluation" << std::endl;
+	logStartupPhase("network", phaseStart);
+
+	if (TB.load(tablebaseDirectory) > 0)
+		std::cout << "Loaded " << TB.tableCount() << " endgame tables from " << tablebaseDirectory << " (up to " << TB.maxPieces() << " pieces)" << std::endl;
+	else if (tablebaseDirectory != TABLEBASE_DIRECTORY)
+		std::cerr << "No endgame tables found in " << tablebaseDirectory << std::endl;
+	logStartupPhase("tablebases", phaseStart);
+
+	// In book the AI answers at once with a weighted random book move
+	OpeningBook book;
+	if (book.open(bookFile))
+		std::cout << "Opened book " << bookFile << " (" << book.size() << " entries)" << std::endl;
+	else if (bookFile != BOOK_FILE)
+		std::cerr << "Could not open book " << bookFile << std::endl;
+	logStartupPhase("book", phaseStart);
+	std::mt19937_64 bookRng(std::random_device{}());
+	// Book moves of the position on the board, redone when the position changes
+	uint64_t bookLinesKey = 0;
+	std::vector<std::string> bookLines;
+
+	initBitboards();
+	TT.resize(HASH_SIZE_MB, true, searchThreads);
+	logStartupPhase("hash table", phaseStart);
+	logStartupPhase("total", startupStart);
+	// Every move played is kept so it can be taken back (left arrow) and played again (right arrow).
+	// Ctrl+C copies the FEN of the position on the board, Ctrl+V starts over from a copied FEN
+	Position startPosition;
+	if (!startPosition.setFromFen(startFen))
+	{
+		std::cerr << "Invalid FEN " << startFen << ", starting from the initial position" << std::endl;
+		startPosition.setStartPosition();
+	}
+	GameState game(startPosition);
+	const Position &position = game.position();
+
+	// Player vs AI: press 'a' to let the AI play the black pieces
+	// The AI thinks on the engine thread, the loop below only starts searches and polls for moves
+	Engine engine;
+	engine.setThreads(searchThreads);
+	uint32_t aiSearchId = 0;
+	// Pondering: after its move the AI keeps searching the reply it expects while the human thinks
+	uint32_t ponderSearchId = 0;
+	Move ponderMove = MOVE_NONE;
+	bool isAIEnabled = false;
+	Color aiColor = BLACK;
+
+	// Press 'h' to mark pieces that can be won by static exchange in red
+	bool isHangingShown = false;
 
 	bool isRunning = true;
 	SDL_Event event;
@@ -573,20 +728,47 @@ int main(int argc, char *argv[])
 	int draggingX = -1, draggingY = -1;
 	int hoveredRow = -1, hoveredCol = -1;
 
+	// Frames are only drawn when something changed. Otherwise the loop sleeps in SDL until the next
+	// event, waking up every ENGINE_POLL_MS while the AI thinks to pick up its move
+	bool needsRedraw = true;
+	// The pieces are rebuilt for a new window size once it has not changed for RESIZE_SETTLE_MS, not
+	// at every size a drag passes through. Until then the old sprites are drawn stretched
+	bool isResizePending = false;
+	Uint32 lastResizeTicks = 0;
 	while (isRunning) // TODO: maybe for chess game do not need to check if isRunning
 	{
-		while (SDL_PollEvent(&event))
+		uint64_t loopStart = SDL_GetPerformanceCounter();
+		std::clock_t loopCpuStart = std::clock();
+		int waitMs = needsRedraw ? 0 : aiSearchId != 0 ? ENGINE_POLL_MS : IDLE_WAIT_MS;
+		if (isResizePending)
+			waitMs = std::min(waitMs, int(RESIZE_SETTLE_MS - std::min(RESIZE_SETTLE_MS, SDL_GetTicks() - lastResizeTicks)));
+		for (bool hasEvent = SDL_WaitEventTimeout(&event, waitMs) != 0; hasEvent; hasEvent = SDL_PollEvent(&event) != 0)
 		{
+			// Moving the mouse changes nothing on the board unless a piece is held
+			if (event.type != SDL_MOUSEMOTION || pieceSelected)
+				needsRedraw = true;
+
 			if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE))
 			{
 				isRunning = false;
 			}
+			else if (event.type == SDL_RENDER_TARGETS_RESET)
+			{
+				// The driver dropped the contents of the target textures (Direct3D device loss)
+				SDL_DestroyTexture(boardLayer);
+				boardLayer = createBoardLayer(renderer, text);
+				isSceneValid = false;
+			}
+			else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+			{
+				isResizePending = true;
+				lastResizeTicks = SDL_GetTicks();
+			}
 			else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT)
 			{
 				selectedRedTiles.clear();
 
-				int mouseX, mouseY;
-				SDL_GetMouseState(&mouseX, &mouseY);
+				int mouseX = event.button.x, mouseY = event.button.y;
 
 				if (event.button.button && isMenuVisible)
 				{
@@ -600,15 +782,14 @@ int main(int argc, char *argv[])
 					}
 				}
 
-				// Check if a piece is selected
-				if (board[mouseY / TILE_SIZE][mouseX / TILE_SIZE] != 0)
+				// Check if a piece is selected. The board is the AI's while it is thinking
+				if (aiSearchId == 0 && isPointOnBoard(mouseX, mouseY) && position.pieceOn(squareFromTile(mouseY / TILE_SIZE, mouseX / TILE_SIZE)) != EMPTY)
 				{
 					SDL_SetCursor(SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_HAND));
 					pieceColSelected = mouseX / TILE_SIZE;
 					pieceRowSelected = mouseY / TILE_SIZE;
 					pieceSelected = true;
-					draggedPiece = board[pieceRowSelected][pieceColSelected];
-					board[pieceRowSelected][pieceColSelected] = 0;
+					draggedPiece = position.pieceOn(squareFromTile(pieceRowSelected, pieceColSelected));
 
 					dragging = true;
 					draggingX = mouseX;
@@ -620,13 +801,12 @@ int main(int argc, char *argv[])
 			}
 			else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_RIGHT)
 			{
-				int mouseX, mouseY;
-				SDL_GetMouseState(&mouseX, &mouseY);
+				int mouseX = event.button.x, mouseY = event.button.y;
 
 				pieceSelected = false;
 				dragging = false;
 				draggedPiece = 0;
-				bool tileFound = false;
+				bool tileFound = !isPointOnBoard(mouseX, mouseY); // clicks on the side panel mark nothing
 
 				for (int i = 0; i < static_cast<int>(selectedRedTiles.size()); i++)
 				{
@@ -649,24 +829,41 @@ int main(int argc, char *argv[])
 			}
 			else if (event.type == SDL_MOUSEBUTTONUP)
 			{
-				int mouseX, mouseY;
-				SDL_GetMouseState(&mouseX, &mouseY);
+				int mouseX = event.button.x, mouseY = event.button.y;
 
 				if (pieceSelected)
 				{
 					if (dragging)
 					{
-						pieceColDragged = mouseX / TILE_SIZE;
-						pieceRowDragged = mouseY / TILE_SIZE;
-						if (isValidMove(board, draggedPiece, pieceRowSelected, pieceColSelected, pieceRowDragged, pieceColDragged))
+						bool isOnBoard = isPointOnBoard(mouseX, mouseY);
+						pieceColDragged = isOnBoard ? mouseX / TILE_SIZE : -1;
+						pieceRowDragged = isOnBoard ? mouseY / TILE_SIZE : -1;
+						Move move = findLegalMove(position, pieceRowSelected, pieceColSelected, pieceRowDragged, pieceColDragged);
+						if (move != MOVE_NONE)
 						{
 							std::cout << "Valid move from: (Row: " << pieceRowSelected << ", Col: " << pieceColSelected << ") to (Row: " << pieceRowDragged << ", Col: " << pieceColDragged << ")" << std::endl;
-							board[pieceRowDragged][pieceColDragged] = draggedPiece;
+
+							// Ponder hit: the running search carries on as the AI's search with its tree
+							// and hash intact. On a miss it is dropped and a fresh search starts below,
+							// still finding everything the ponder search stored in the hash table
+							if (ponderSearchId != 0)
+							{
+								if (move == ponderMove)
+								{
+									engine.ponderHit();
+									aiSearchId = ponderSearchId;
+								}
+								else
+								{
+									engine.stop();
+								}
+								ponderSearchId = 0;
+							}
+							playMove(game, move);
 							SDL_SetCursor(SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW));
 						}
 						else
 						{
-							board[pieceRowSelected][pieceColSelected] = draggedPiece;
 							// draggedPiece = 0;
 							pieceColSelected = -1;
 							pieceRowSelected = -1;
@@ -679,7 +876,6 @@ int main(int argc, char *argv[])
 					}
 					else
 					{
-						board[pieceRowSelected][pieceColSelected] = draggedPiece;
 						// draggedPiece = 0;
 						pieceColSelected = -1;
 						pieceRowSelected = -1;
@@ -696,52 +892,238 @@ int main(int argc, char *argv[])
 			}
 			else if (event.type == SDL_MOUSEMOTION)
 			{
-				SDL_GetMouseState(&draggingX, &draggingY);
+				draggingX = event.motion.x;
+				draggingY = event.motion.y;
 
 				if (pieceSelected)
 				{
 					dragging = true;
-					hoveredRow = draggingY / TILE_SIZE;
-					hoveredCol = draggingX / TILE_SIZE;
+					bool isOnBoard = isPointOnBoard(draggingX, draggingY);
+					hoveredRow = isOnBoard ? draggingY / TILE_SIZE : -1;
+					hoveredCol = isOnBoard ? draggingX / TILE_SIZE : -1;
 				}
 			}
 			else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_m)
 			{
 				isMenuVisible = !isMenuVisible;
 			}
-		}
+			else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_a)
+			{
+				isAIEnabled = !isAIEnabled;
+				std::cout << "Player vs AI: " << (isAIEnabled ? "on" : "off") << std::endl;
 
-		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-		SDL_RenderClear(renderer);
+				if (!isAIEnabled)
+					stopAI(engine, aiSearchId, ponderSearchId);
+			}
+			else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_h)
+			{
+				isHangingShown = !isHangingShown;
+			}
+			else if (event.type == SDL_KEYDOWN && (event.key.keysym.mod & KMOD_CTRL) && event.key.keysym.sym == SDLK_c)
+			{
+				std::string fen = position.fen();
+				SDL_SetClipboardText(fen.c_str());
+				std::cout << "Copied FEN: " << fen << std::endl;
+			}
+			else if (event.type == SDL_KEYDOWN && (event.key.keysym.mod & KMOD_CTRL) && event.key.keysym.sym == SDLK_v)
+			{
+				char *text = SDL_GetClipboardText();
+				Position pasted;
+				if (text && pasted.setFromFen(text))
+				{
+					stopAI(engine, aiSearchId, ponderSearchId);
+					game.reset(pasted);
+					pieceSelected = false;
+					dragging = false;
+					draggedPiece = 0;
+					pieceRowSelected = pieceColSelected = pieceRowDragged = pieceColDragged = -1;
+					std::cout << "Loaded FEN: " << position.fen() << std::endl;
+					logGameStatus(position);
+				}
+				else
+				{
+					std::cerr << "The clipboard holds no valid FEN" << std::endl;
+				}
+				SDL_free(text);
+			}
+			else if (event.type == SDL_KEYDOWN && (event.key.keysym.sym == SDLK_LEFT || event.key.keysym.sym == SDLK_RIGHT))
+			{
+				stopAI(engine, aiSearchId, ponderSearchId);
+				stepThroughGame(game, event.key.keysym.sym == SDLK_LEFT, isAIEnabled, aiColor);
+
+				// Highlight the move that led to the position now on the board
+				Move lastMove = game.lastMove();
+				pieceSelected = false;
+				dragging = false;
+				draggedPiece = 0;
+				pieceRowSelected = lastMove != MOVE_NONE ? tileRow(moveFrom(lastMove)) : -1;
+				pieceColSelected = lastMove != MOVE_NONE ? tileCol(moveFrom(lastMove)) : -1;
+				pieceRowDragged = lastMove != MOVE_NONE ? tileRow(moveTo(lastMove)) : -1;
+				pieceColDragged = lastMove != MOVE_NONE ? tileCol(moveTo(lastMove)) : -1;
+			}
+		}
 
-		if (isMenuVisible)
+		// A resized window, or one moved to a display with other scaling, covers a tile with another
+		// number of pixels. Sizes seen before come back from the cache
+		if (isResizePending && SDL_GetTicks() - lastResizeTicks >= RESIZE_SETTLE_MS)
 		{
-			renderMenu(renderer, font);
+			isResizePending = false;
+			int size = pieceSpriteSize(renderer);
+			if (size != pieces.spriteSize())
+			{
+				buildPieces(renderer, pieces, size);
+				SDL_DestroyTexture(scene);
+				scene = createScene(renderer, sceneScaleX, sceneScaleY);
+				isSceneValid = false;
+				needsRedraw = true;
+			}
 		}
-		else
+
+		bool drewFrame = needsRedraw;
+		if (needsRedraw)
 		{
-			renderBoard(renderer);
-			renderBoardNotation(renderer, font);
+			uint64_t frameStart = SDL_GetPerformanceCounter();
+			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+			SDL_RenderClear(renderer);
+
+			if (isMenuVisible)
+			{
+				renderMenu(renderer, text);
+			}
+			else
+			{
+				// Bring the scene up to date where it changed: the squares whose piece or overlays
+				// differ from what is drawn there, and the side panel when the book moves changed
+				SquareLook looks[64];
+				computeSquareLooks(looks, position, pieceSelected, dragging, pieceRowSelected, pieceColSelected, pieceRowDragged, pieceColDragged,
+								   hoveredRow, hoveredCol, selectedRedTiles, isHangingShown);
+				bool isPanelDirty = !isSceneValid;
+				if (position.key() != bookLinesKey)
+				{
+					bookLines = describeBookMoves(position, book.probe(position));
+					bookLinesKey = position.key();
+					isPanelDirty = true;
+				}
+
+				std::vector<SDL_Rect> changedTiles;
+				for (int i = 0; i < 64; i++)
+				{
+					stats.fullPixels += squarePixels(looks[i]);
+					if (isSceneValid && looks[i] == drawnLooks[i])
+						continue;
+					changedTiles.push_back({(i % 8) * TILE_SIZE, (i / 8) * TILE_SIZE, TILE_SIZE, TILE_SIZE});
+					addSquare(pieces, i / 8, i % 8, looks[i]);
+					drawnLooks[i] = looks[i];
+					stats.pixels += squarePixels(looks[i]);
+				}
 
-			// renderHighlightTiles(renderer, pieceSelected, pieceRowSelected, pieceColSelected, pieceRowDragged, pieceColDragged, selectedRedTiles,selectedRedTilesCount);
+				// Drawing in screen coordinates, scaled to the pixels of the scene
+				SDL_SetRenderTarget(renderer, scene);
+				SDL_RenderSetScale(renderer, sceneScaleX, sceneScaleY);
+				restoreTiles(renderer, boardLayer, changedTiles);
+				stats.layerDrawCalls[LAYER_BOARD] += changedTiles.empty() ? 0 : 1;
+				uint64_t pieceCalls = pieces.drawCalls();
+				pieces.flush(renderer);
+				stats.layerDrawCalls[LAYER_PIECES] += pieces.drawCalls() - pieceCalls;
+				if (isPanelDirty)
+				{
+					uint64_t textCalls = text.drawCalls();
+					renderBookPanel(renderer, text, book.isOpen(), bookLines);
+					stats.layerDrawCalls[LAYER_BOARD] += 1 + (text.drawCalls() - textCalls);
+					stats.pixels += uint64_t(SIDE_PANEL_WIDTH) * SCREEN_HEIGHT;
+				}
+				SDL_SetRenderTarget(renderer, nullptr);
+				isSceneValid = true;
+
+				SDL_RenderCopy(renderer, scene, nullptr, nullptr);
+				stats.layerDrawCalls[LAYER_BOARD]++;
+				stats.pixels += uint64_t(SCREEN_WIDTH) * SCREEN_HEIGHT;
+				// Drawing everything straight to the screen also takes the coordinates and the panel
+				stats.fullPixels += uint64_t(SIDE_PANEL_WIDTH) * SCREEN_HEIGHT;
+
+				if (dragging && draggedPiece != 0)
+				{
+					pieces.addPiece(draggedPiece, {draggingX - TILE_SIZE / 2, draggingY - TILE_SIZE / 2, TILE_SIZE, TILE_SIZE});
+					pieceCalls = pieces.drawCalls();
+					pieces.flush(renderer);
+					stats.layerDrawCalls[LAYER_DRAGGED] += pieces.drawCalls() - pieceCalls;
+					stats.pixels += TILE_SIZE * TILE_SIZE;
+					stats.fullPixels += TILE_SIZE * TILE_SIZE;
+				}
+				stats.frames++;
+			}
+
+			SDL_RenderPresent(renderer);
+			recordFrameTime(stats, double(SDL_GetPerformanceCounter() - frameStart) * 1000 / SDL_GetPerformanceFrequency());
+			needsRedraw = false;
+		}
 
-			renderHighlightSelectedPieceTile(renderer, pieceSelected, pieceRowSelected, pieceColSelected);
-			renderHoveredTileBorder(renderer, hoveredRow, hoveredCol, dragging);
-			renderHighlightDraggedPieceTile(renderer, pieceSelected, pieceRowDragged, pieceColDragged);
-			renderHighlightRedTile(renderer, pieceSelected, selectedRedTiles);
-			//renderCircleInsideTile(renderer);
-			renderPiecesInBoard(renderer, pieces, board);
+		// The AI starts thinking once the human move has been drawn and the board keeps rendering
+		// while it does. Its move is picked up on the first frame after the search finishes
+		if (isAIEnabled && !isMenuVisible && aiSearchId == 0 && position.sideToMove() == aiColor)
+		{
+			Move bookMove = book.pick(position, bookRng);
+			if (bookMove != MOVE_NONE)
+			{
+				std::cout << "AI book move: " << moveToSan(position, bookMove) << std::endl;
+				pieceRowSelected = tileRow(moveFrom(bookMove));
+				pieceColSelected = tileCol(moveFrom(bookMove));
+				pieceRowDragged = tileRow(moveTo(bookMove));
+				pieceColDragged = tileCol(moveTo(bookMove));
+				playMove(game, bookMove);
+				needsRedraw = true;
+			}
+			else
+			{
+				aiSearchId = startAISearch(engine, game);
+			}
+		}
 
-			if (dragging && draggedPiece != 0)
+		EngineEvent engineEvent;
+		while (engine.poll(engineEvent))
+		{
+			if (!engineEvent.finished || engineEvent.searchId != aiSearchId)
+				continue;
+
+			aiSearchId = 0;
+			needsRedraw = true;
+			const SearchResult &result = engineEvent.result;
+			Move move = result.bestMove;
+			if (move != MOVE_NONE)
+			{
+				std::cout << "AI move: " << moveToUci(move) << " (depth " << result.depth << ", score " << result.score << ", nodes " << result.nodes << ")" << std::endl;
+				pieceRowSelected = tileRow(moveFrom(move));
+				pieceColSelected = tileCol(moveFrom(move));
+				pieceRowDragged = tileRow(moveTo(move));
+				pieceColDragged = tileCol(moveTo(move));
+				playMove(game, move);
+
+				if (result.ponderMove != MOVE_NONE && position.isLegal(result.ponderMove))
+				{
+					ponderMove = result.ponderMove;
+					ponderSearchId = startPondering(engine, game, ponderMove);
+				}
+			}
+			else
 			{
-				SDL_Rect rect = {draggingX - TILE_SIZE / 2, draggingY - TILE_SIZE / 2, TILE_SIZE, TILE_SIZE};
-				SDL_RenderCopy(renderer, pieces[draggedPiece - 1], NULL, &rect);
+				isAIEnabled = false;
 			}
 		}
 
-		SDL_RenderPresent(renderer);
+		if (!drewFrame && aiSearchId == 0 && ponderSearchId == 0)
+		{
+			stats.idleSeconds += double(SDL_GetPerformanceCounter() - loopStart) / SDL_GetPerformanceFrequency();
+			stats.idleCpuSeconds += double(std::clock() - loopCpuStart) / CLOCKS_PER_SEC;
+		}
 	}
 
+	std::cout << "Text: " << text.texturesCreated() << " texture(s) created, " << text.glyphsDrawn() << " glyphs in " << text.drawCalls() << " draw calls" << std::endl;
+	std::cout << "Pieces: " << pieces.texturesCreated() << " texture(s) created, " << pieces.quadsDrawn() << " quads in " << pieces.drawCalls() << " draw calls" << std::endl;
+	printRenderStats(stats);
+	SDL_DestroyTexture(scene);
+	SDL_DestroyTexture(boardLayer);
+	pieces.release();
+	text.release();
 	TTF_CloseFont(font);
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
@@ -0,0 +1,165 @@
+#include "engine.h"
+
+#include <chrono>
+
+Engine::Engine()
+{
+	worker = std::thread(&Engine::loop, this);
+}
+
+Engine::~Engine()
+{
+	quitting.store(true, std::memory_order_relaxed);
+	stop();
+	Command command;
+	command.type = CMD_QUIT;
+	push(std::move(command));
+	worker.join();
+}
+
+void Engine::push(Command &&command)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		commands.push_back(std::move(command));
+	}
+	wakeUp.notify_one();
+}
+
+void Engine::setThreads(int count)
+{
+	Command command;
+	command.type = CMD_THREADS;
+	command.threads = count;
+	push(std::move(command));
+}
+
+void Engine::setPosition(const Position &position, const std::vector<uint64_t> &history)
+{
+	Command command;
+	command.type = CMD_POSITION;
+	command.position = position;
+	command.history = history;
+	push(std::move(command));
+}
+
+uint32_t Engine::go(const SearchLimits &limits, bool ponder)
+{
+	Command command;
+	command.type = CMD_GO;
+	command.limits = limits;
+	command.ponder = ponder;
+	uint32_t id;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		id = command.searchId = ++lastSearchId;
+		pendingSearches.fetch_add(1, std::memory_order_release);
+		commands.push_back(std::move(command));
+	}
+	wakeUp.notify_one();
+	return id;
+}
+
+void Engine::stop()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stoppedUpTo = lastSearchId;
+	search.stop();
+}
+
+void Engine::ponderHit()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	ponderHitUpTo = lastSearchId;
+	search.ponderHit();
+}
+
+bool Engine::poll(EngineEvent &event)
+{
+	return events.pop(event);
+}
+
+bool Engine::waitForEvent(EngineEvent &event, int timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(eventMutex);
+	if (events.pop(event))
+		return true;
+	eventReady.wait_for(lock, std::chrono::milliseconds(timeoutMs));
+	return events.pop(event);
+}
+
+// Function to hand an event to the polling thread. Iteration reports are dropped when the ring is
+// full, the final result waits for room because the caller needs it (unless nobody will poll again)
+void Engine::publish(const EngineEvent &event, bool mustDeliver)
+{
+	bool pushed;
+	while (!(pushed = events.push(event)) && mustDeliver && !quitting.load(std::memory_order_relaxed))
+		std::this_thread::yield();
+
+	// Taking the lock orders the push with a waiter that just found the ring empty, so the
+	// notification cannot slip in before it sleeps
+	if (pushed)
+	{
+		{
+			std::lock_guard<std::mutex> lock(eventMutex);
+		}
+		eventReady.notify_one();
+	}
+}
+
+void Engine::loop()
+{
+	Position position;
+	position.setStartPosition();
+	std::vector<uint64_t> history;
+
+	while (true)
+	{
+		Command command;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeUp.wait(lock, [this]()
+						{ return !commands.empty(); });
+			command = std::move(commands.front());
+			commands.pop_front();
+
+			// Decided under the lock so a stop() or ponderHit() racing with the start of the search is never lost
+			if (command.type == CMD_GO)
+			{
+				if (command.searchId > stoppedUpTo)
+					search.clearStop();
+				else
+					search.stop();
+				search.setPondering(command.ponder && command.searchId > ponderHitUpTo);
+			}
+		}
+
+		if (command.type == CMD_QUIT)
+			return;
+		if (command.type == CMD_THREADS)
+			search.setThreads(command.threads);
+		else if (command.type == CMD_POSITION)
+		{
+			position = command.position;
+			history = std::move(command.history);
+		}
+		else if (command.type == CMD_GO)
+		{
+			uint32_t id = command.searchId;
+			search.onIteration = [this, id](const SearchResult &result)
+			{
+				EngineEvent event;
+				event.searchId = id;
+				event.result = result;
+				publish(event, false);
+			};
+
+			EngineEvent event;
+			event.searchId = id;
+			event.finished = true;
+			event.result = search.run(position, history, command.limits);
+			publish(event, true);
+			pendingSearches.fetch_sub(1, std::memory_order_release);
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "position.h"
+#include "search.h"
+
+// Single producer, single consumer ring. push and pop never block or lock; one thread may push
+// and one other thread may pop at the same time
+template <typename T, size_t Capacity>
+class SpscRing
+{
+public:
+	// Returns false when the ring is full
+	bool push(const T &value)
+	{
+		size_t tail = writeIndex.load(std::memory_order_relaxed);
+		if (tail - readIndex.load(std::memory_order_acquire) == Capacity)
+			return false;
+		slots[tail % Capacity] = value;
+		writeIndex.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Returns false when the ring is empty
+	bool pop(T &value)
+	{
+		size_t head = readIndex.load(std::memory_order_relaxed);
+		if (head == writeIndex.load(std::memory_order_acquire))
+			return false;
+		value = slots[head % Capacity];
+		readIndex.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T slots[Capacity];
+	alignas(64) std::atomic<size_t> writeIndex{0};
+	alignas(64) std::atomic<size_t> readIndex{0};
+};
+
+// What the engine thread reports: one event per finished iteration, then the final result
+struct EngineEvent
+{
+	uint32_t searchId = 0;
+	bool finished = false;
+	SearchResult result;
+};
+
+// Runs searches on a thread of its own so the caller (the SDL loop, the UCI reader) never waits.
+// Commands go through a queue and are handled in order; results come back through a lock free
+// ring the caller polls
+class Engine
+{
+public:
+	Engine();
+	~Engine();
+
+	void setThreads(int count);
+	void setPosition(const Position &position, const std::vector<uint64_t> &history);
+	// Starts a search of the last position set, returns the id its events will carry. A pondering
+	// search ignores its time limits until ponderHit() and never finishes on its own before that
+	uint32_t go(const SearchLimits &limits, bool ponder = false);
+	// The expected move was played: the pondering search (running or queued) turns into a normal one
+	void ponderHit();
+	// Ends the running search and any queued one. Takes effect straight away, not in queue order:
+	// the search notices on its next node and reports its best move so far
+	void stop();
+
+	// Takes the next event if there is one, never blocks
+	bool poll(EngineEvent &event);
+	// Takes the next event, sleeping up to timeoutMs for one. Wakes as soon as the engine thread
+	// publishes, for callers with nothing else to do (the UCI output thread)
+	bool waitForEvent(EngineEvent &event, int timeoutMs);
+	// True from go() until the final event of that search has been pushed
+	bool isSearching() const { return pendingSearches.load(std::memory_order_acquire) > 0; }
+
+private:
+	enum CommandType
+	{
+		CMD_THREADS,
+		CMD_POSITION,
+		CMD_GO,
+		CMD_QUIT
+	};
+
+	struct Command
+	{
+		CommandType type;
+		uint32_t searchId = 0;
+		int threads = 1;
+		bool ponder = false;
+		Position position;
+		std::vector<uint64_t> history;
+		SearchLimits limits;
+	};
+
+	void loop();
+	void push(Command &&command);
+	void publish(const EngineEvent &event, bool mustDeliver);
+
+	Search search;
+	std::thread worker;
+
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::deque<Command> commands;
+	uint32_t lastSearchId = 0;
+	uint32_t stoppedUpTo = 0;	 // searches with an id up to this one were stopped before they finished
+	uint32_t ponderHitUpTo = 0; // and these no longer ponder
+
+	std::atomic<int> pendingSearches{0};
+	std::atomic<bool> quitting{false};
+	SpscRing<EngineEvent, 256> events;
+	std::mutex eventMutex;
+	std::condition_variable eventReady;
+};
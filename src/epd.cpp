@@ -0,0 +1,317 @@
+// Headless test suite runner: checks every position of an EPD file against its opcodes, several
+// positions at a time
+//   epd [-t threads] [-d depth] [-m movetimeMs] [-H hashMB] [-p maxPerftDepth] suite.epd
+// Opcodes checked:
+//   bm <moves>       the search has to pick one of these (SAN or coordinate notation)
+//   am <moves>       the search has to pick none of these
+//   D<n> <count>     perft to depth n counts this many leaves, as in perft suites
+//   id "<name>"      names the position in the report
+// Each thread searches its own position on one thread. The searches share the hash table, so
+// with more than one thread the results can vary a little from run to run
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "position.h"
+#include "search.h"
+#include "tt.h"
+
+const int DEFAULT_DEPTH = 10;
+const int DEFAULT_HASH_MB = 64;
+const int DEFAULT_MAX_PERFT_DEPTH = 5;
+
+struct EpdTest
+{
+	int line = 0;
+	std::string id;
+	Position position;
+	std::vector<Move> bestMoves;
+	std::vector<Move> avoidMoves;
+	std::vector<std::pair<int, uint64_t>> perftCounts; // depth, leaves
+};
+
+struct EpdOptions
+{
+	int threads = 1;
+	SearchLimits limits;
+	size_t hashMb = DEFAULT_HASH_MB;
+	int maxPerftDepth = DEFAULT_MAX_PERFT_DEPTH;
+	std::string path;
+};
+
+// Totals over the suite, updated by every thread under the report lock
+struct EpdSummary
+{
+	int searched = 0;
+	int solved = 0;
+	int perftChecked = 0;
+	int perftPassed = 0;
+	uint64_t nodes = 0;
+};
+
+// Function to split the operations of an EPD line on the semicolons outside quotes
+static std::vector<std::string> splitOperations(const std::string &text)
+{
+	std::vector<std::string> operations;
+	std::string current;
+	bool quoted = false;
+	for (char c : text)
+	{
+		if (c == '"')
+			quoted = !quoted;
+		if (c == ';' && !quoted)
+		{
+			operations.push_back(current);
+			current.clear();
+		}
+		else
+			current += c;
+	}
+	if (current.find_first_not_of(" \t\r") != std::string::npos)
+		operations.push_back(current);
+	return operations;
+}
+
+// Function to read one EPD line: four FEN fields then the operations. False for lines without a position
+static bool parseEpdLine(const std::string &line, EpdTest &test)
+{
+	std::istringstream stream(line);
+	std::string fields[4];
+	for (std::string &field : fields)
+	{
+		if (!(stream >> field))
+			return false;
+	}
+	if (!test.position.setFromFen(fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3]))
+		return false;
+
+	std::string rest;
+	std::getline(stream, rest);
+	for (const std::string &operation : splitOperations(rest))
+	{
+		std::istringstream operands(operation);
+		std::string opcode, operand;
+		if (!(operands >> opcode))
+			continue;
+
+		if (opcode == "bm" || opcode == "am")
+		{
+			while (operands >> operand)
+			{
+				Move move = moveFromSan(test.position, operand);
+				if (move == MOVE_NONE)
+					move = moveFromUci(test.position, operand);
+				if (move == MOVE_NONE)
+				{
+					std::cerr << "line " << test.line << ": " << operand << " is not a legal move" << std::endl;
+					continue;
+				}
+				(opcode == "bm" ? test.bestMoves : test.avoidMoves).push_back(move);
+			}
+		}
+		else if (opcode.size() >= 2 && opcode[0] == 'D' && std::isdigit(static_cast<unsigned char>(opcode[1])))
+		{
+			uint64_t count;
+			if (operands >> count)
+				test.perftCounts.push_back({std::atoi(opcode.c_str() + 1), count});
+		}
+		else if (opcode == "id")
+		{
+			std::getline(operands, operand);
+			size_t first = operand.find('"'), last = operand.rfind('"');
+			test.id = first != std::string::npos && last > first ? operand.substr(first + 1, last - first - 1) : operand;
+		}
+	}
+
+	if (test.id.empty())
+		test.id = "line " + std::to_string(test.line);
+	return true;
+}
+
+static uint64_t perft(Position &position, int depth)
+{
+	MoveList list;
+	position.generateLegalMoves(list);
+	if (depth == 1)
+		return list.size();
+
+	uint64_t nodes = 0;
+	for (Move move : list)
+	{
+		UndoInfo undo;
+		position.makeMove(move, undo);
+		nodes += perft(position, depth - 1);
+		position.unmakeMove(move, undo);
+	}
+	return nodes;
+}
+
+// Function to write the moves of a list in SAN, separated by spaces
+static std::string formatMoves(const Position &position, const std::vector<Move> &moves)
+{
+	std::string text;
+	for (Move move : moves)
+		text += (text.empty() ? "" : " ") + moveToSan(position, move);
+	return text;
+}
+
+// Function to run the checks of one position and write its report line
+static void runTest(const EpdTest &test, const EpdOptions &options, Search &search, EpdSummary &summary, std::mutex &reportMutex)
+{
+	std::ostringstream report;
+	report << test.id << ":";
+	int searched = 0, solved = 0, perftChecked = 0, perftPassed = 0;
+	uint64_t nodes = 0;
+
+	if (!test.bestMoves.empty() || !test.avoidMoves.empty())
+	{
+		SearchResult result = search.run(test.position, std::vector<uint64_t>(), options.limits);
+		bool found = std::find(test.bestMoves.begin(), test.bestMoves.end(), result.bestMove) != test.bestMoves.end();
+		bool avoided = std::find(test.avoidMoves.begin(), test.avoidMoves.end(), result.bestMove) == test.avoidMoves.end();
+		searched = 1;
+		solved = (test.bestMoves.empty() || found) && avoided ? 1 : 0;
+		nodes = result.nodes;
+
+		report << (solved ? " ok  " : " FAIL") << " played " << (result.bestMove != MOVE_NONE ? moveToSan(test.position, result.bestMove) : "none");
+		if (!test.bestMoves.empty())
+			report << "  bm " << formatMoves(test.position, test.bestMoves);
+		if (!test.avoidMoves.empty())
+			report << "  am " << formatMoves(test.position, test.avoidMoves);
+		report << "  (depth " << result.depth << ", score " << result.score << ", nodes " << result.nodes << ")";
+	}
+
+	for (const std::pair<int, uint64_t> &expected : test.perftCounts)
+	{
+		if (expected.first < 1 || expected.first > options.maxPerftDepth)
+			continue;
+		Position position = test.position;
+		uint64_t count = perft(position, expected.first);
+		perftChecked++;
+		if (count == expected.second)
+		{
+			perftPassed++;
+			report << "  D" << expected.first << " ok";
+		}
+		else
+			report << "  D" << expected.first << " FAIL " << count << " expected " << expected.second;
+	}
+
+	std::lock_guard<std::mutex> lock(reportMutex);
+	summary.searched += searched;
+	summary.solved += solved;
+	summary.perftChecked += perftChecked;
+	summary.perftPassed += perftPassed;
+	summary.nodes += nodes;
+	std::cout << report.str() << std::endl;
+}
+
+static void printUsage()
+{
+	std::cerr << "usage: epd [-t threads] [-d depth] [-m movetimeMs] [-H hashMB] [-p maxPerftDepth] suite.epd" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	EpdOptions options;
+	options.threads = int(std::max(1u, std::thread::hardware_concurrency()));
+	bool depthGiven = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-t" && hasValue)
+			options.threads = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-d" && hasValue)
+		{
+			options.limits.depth = std::max(1, std::min(std::atoi(argv[++i]), MAX_PLY - 1));
+			depthGiven = true;
+		}
+		else if (arg == "-m" && hasValue)
+			options.limits.moveTime = std::atoll(argv[++i]);
+		else if (arg == "-H" && hasValue)
+			options.hashMb = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-p" && hasValue)
+			options.maxPerftDepth = std::atoi(argv[++i]);
+		else if (options.path.empty() && arg[0] != '-')
+			options.path = arg;
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	if (options.path.empty())
+	{
+		printUsage();
+		return 1;
+	}
+	// A move time alone searches as deep as the time allows
+	if (!depthGiven && !options.limits.moveTime)
+		options.limits.depth = DEFAULT_DEPTH;
+
+	initBitboards();
+
+	std::ifstream file(options.path);
+	if (!file)
+	{
+		std::cerr << "cannot read " << options.path << std::endl;
+		return 1;
+	}
+
+	std::vector<EpdTest> tests;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		EpdTest test;
+		test.line = ++lineNumber;
+		if (parseEpdLine(line, test))
+			tests.push_back(test);
+		else if (line.find_first_not_of(" \t\r") != std::string::npos && line[0] != '#')
+			std::cerr << "line " << lineNumber << ": not a position, skipped" << std::endl;
+	}
+
+	TT.resize(options.hashMb, true, options.threads);
+	options.threads = std::min(options.threads, int(tests.size()));
+	std::cout << tests.size() << " positions from " << options.path << ", " << options.threads << " at a time" << std::endl;
+
+	// Positions are handed out one at a time, so a slow perft does not hold up a whole share
+	EpdSummary summary;
+	std::mutex reportMutex;
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		Search search;
+		for (size_t i = next++; i < tests.size(); i = next++)
+			runTest(tests[i], options, search, summary, reportMutex);
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (int i = 0; i < options.threads; i++)
+		pool.emplace_back(worker);
+	for (std::thread &thread : pool)
+		thread.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::endl;
+	if (summary.searched)
+		std::cout << "Solved " << summary.solved << " of " << summary.searched << " (" << 100.0 * summary.solved / summary.searched << "%), nodes "
+				  << summary.nodes << ", nps " << uint64_t(summary.nodes / std::max(seconds, 1e-9)) << std::endl;
+	if (summary.perftChecked)
+		std::cout << "Perft " << summary.perftPassed << " of " << summary.perftChecked << " counts right" << std::endl;
+	std::cout << "Time " << int(seconds * 1000) << " ms" << std::endl;
+
+	// Missed best moves are what a suite measures, wrong perft counts are bugs
+	return summary.perftPassed == summary.perftChecked ? 0 : 1;
+}
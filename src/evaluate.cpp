@@ -0,0 +1,56 @@
+#include "evaluate.h"
+
+#include <algorithm>
+
+// Network scores are kept clear of the mate range the search reserves
+const int MAX_NNUE_SCORE = 20000;
+
+// Function to blend the middlegame and endgame halves by how much material is left
+static int taper(Score score, int phase)
+{
+	phase = std::min(phase, MAX_PHASE);
+	return (score.mg * phase + score.eg * (MAX_PHASE - phase)) / MAX_PHASE;
+}
+
+// Function to add the pawn terms to the material and piece-square sums and score the result for the side to move
+static int handcrafted(const Position &position, Score psq, int phase, PawnEntry &pawns)
+{
+	Score total = psq + pawns.score;
+	total.mg += kingShelter(position, pawns, WHITE) - kingShelter(position, pawns, BLACK);
+	int score = taper(total, phase);
+	return position.sideToMove() == WHITE ? score : -score;
+}
+
+int evaluate(const Position &position, PawnTable &pawns)
+{
+	if (NNUE.loaded())
+		return std::clamp(NNUE.evaluate(position.nnueAccumulator(), position.sideToMove()), -MAX_NNUE_SCORE, MAX_NNUE_SCORE);
+
+	return handcrafted(position, position.psqScore(), position.gamePhase(), pawns.probe(position));
+}
+
+int evaluateFromScratch(const Position &position)
+{
+	if (NNUE.loaded())
+	{
+		Position copy = position;
+		copy.refreshAccumulator();
+		return std::clamp(NNUE.evaluate(copy.nnueAccumulator(), copy.sideToMove()), -MAX_NNUE_SCORE, MAX_NNUE_SCORE);
+	}
+
+	Score psq = {0, 0};
+	int phase = 0;
+	Bitboard occupied = position.occupied();
+
+	while (occupied)
+	{
+		int sq = popLsb(occupied);
+		PieceType piece = position.pieceOn(sq);
+		psq += PSQT.values[piece][sq];
+		phase += PHASE_WEIGHTS[pieceKind(piece)];
+	}
+
+	PawnEntry pawns;
+	evaluatePawns(position, pawns);
+	return handcrafted(position, psq, phase, pawns);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "pawns.h"
+#include "position.h"
+
+const int PIECE_VALUES[7] = {0, 100, 500, 320, 330, 900, 0}; // indexed by PieceKind, for move ordering and pruning
+
+// Static evaluation in centipawns from the point of view of the side to move. Uses the network
+// when one is loaded (see nnue.h), otherwise material and piece-square tables plus pawn structure
+// and king shelter, tapered between middlegame and endgame. The position keeps the material and
+// piece-square sums up to date and the pawn terms come from pawns, the caller's pawn cache
+int evaluate(const Position &position, PawnTable &pawns);
+
+// Same score summed over every piece on the board, for checking and benchmarking the incremental one
+int evaluateFromScratch(const Position &position);
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "position.h"
+
+// Moves a GameState holds: a game plus the search's longest line on top of it. When a game gets
+// longer the oldest half of its moves can no longer be taken back
+const int MAX_GAME_PLIES = 1024;
+// Keys of earlier positions kept by reset(), enough for any repetition the fifty move rule allows
+const int MAX_HISTORY_KEYS = MAX_GAME_PLIES / 2;
+
+// A position with the moves that led to it and what each of them destroyed: castling rights, en
+// passant square, captured piece, fifty move clock and hash key. Moves are taken back and played
+// again in constant time without allocating, so the same stack keeps the game in the GUI and
+// makes and unmakes the moves of the search, whose repetition checks read the keys kept here
+class GameState
+{
+public:
+	GameState() { reset(Position()); }
+	explicit GameState(const Position &start, const std::vector<uint64_t> &history = {}) { reset(start, history); }
+
+	// Starts over from start. history holds the keys of the positions before it (oldest first),
+	// which count for repetitions but cannot be undone to
+	void reset(const Position &start, const std::vector<uint64_t> &history = {})
+	{
+		current = start;
+		base = std::min(int(history.size()), MAX_HISTORY_KEYS);
+		std::copy(history.end() - base, history.end(), keys);
+		ply = top = base;
+		keys[ply] = current.key();
+	}
+
+	const Position &position() const { return current; }
+	// Rebuilds the network accumulator of the position, see Position::refreshAccumulator
+	void refreshAccumulator() { current.refreshAccumulator(); }
+
+	// Plays a legal move. The moves that were undone can no longer be redone
+	void makeMove(Move move)
+	{
+		if (ply == MAX_GAME_PLIES)
+			forgetOldest();
+		plies[ply].move = move;
+		current.makeMove(move, plies[ply].undo);
+		keys[++ply] = current.key();
+		top = ply;
+	}
+
+	// Passes the turn, for null move pruning. Taken back with undo() like a move
+	void makeNullMove()
+	{
+		if (ply == MAX_GAME_PLIES)
+			forgetOldest();
+		plies[ply].move = MOVE_NONE;
+		current.makeNullMove(plies[ply].undo);
+		keys[++ply] = current.key();
+		top = ply;
+	}
+
+	// Takes back the last move, which stays available to redo()
+	void undo()
+	{
+		Ply &last = plies[--ply];
+		if (last.move == MOVE_NONE)
+			current.unmakeNullMove(last.undo);
+		else
+			current.unmakeMove(last.move, last.undo);
+	}
+
+	// Plays the last move undone again
+	void redo()
+	{
+		Ply &next = plies[ply];
+		if (next.move == MOVE_NONE)
+			current.makeNullMove(next.undo);
+		else
+			current.makeMove(next.move, next.undo);
+		ply++;
+	}
+
+	bool canUndo() const { return ply > base; }
+	bool canRedo() const { return ply < top; }
+	// Move that led to the position, MOVE_NONE at the start or after a null move
+	Move lastMove() const { return canUndo() ? plies[ply - 1].move : MOVE_NONE; }
+
+	// Fifty move rule, or the position occurred before with the same side to move (once is enough
+	// for the search: whatever was good there can be repeated)
+	bool isDraw() const
+	{
+		if (current.halfmoves() >= 100)
+			return true;
+
+		// Only positions since the last capture or pawn move can repeat, and only with the same side to move
+		int stopAt = std::max(0, ply - current.halfmoves());
+		for (int i = ply - 4; i >= stopAt; i -= 2)
+		{
+			if (keys[i] == keys[ply])
+				return true;
+		}
+		return false;
+	}
+
+	// Keys of the positions before this one, oldest first, as the engine takes them with the position
+	std::vector<uint64_t> history() const { return std::vector<uint64_t>(keys, keys + ply); }
+
+private:
+	struct Ply
+	{
+		Move move;
+		UndoInfo undo;
+	};
+
+	// Makes room by keeping the last MAX_HISTORY_KEYS plies and their keys. Older moves and keys are discarded
+	void forgetOldest()
+	{
+		int drop = ply - MAX_HISTORY_KEYS;
+		std::memmove(plies, plies + drop, (ply - drop) * sizeof(Ply));
+		std::memmove(keys, keys + drop, (ply - drop + 1) * sizeof(uint64_t));
+		base = std::max(0, base - drop);
+		ply -= drop;
+		top = ply;
+	}
+
+	Position current;
+	// keys[i] is the key of the position after i plies, plies[i] the move played from it. Below
+	// base there are keys only
+	uint64_t keys[MAX_GAME_PLIES + 1];
+	Ply plies[MAX_GAME_PLIES];
+	int base = 0;
+	int ply = 0;
+	int top = 0;
+};
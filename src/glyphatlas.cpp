@@ -0,0 +1,155 @@
+#include "glyphatlas.h"
+
+#include <algorithm>
+#include <iostream>
+
+bool GlyphAtlas::build(SDL_Renderer *renderer, TTF_Font *atlasFont)
+{
+	release();
+	if (!atlasFont)
+		return false;
+	font = atlasFont;
+	height = TTF_FontHeight(font);
+
+	// Lay the glyphs out in rows, one pixel apart so filtering never bleeds a neighbour in
+	const SDL_Color white = {255, 255, 255, 255};
+	SDL_Surface *surfaces[LAST_CHAR - FIRST_CHAR + 1];
+	int x = 0, y = 0, rowHeight = 0;
+	for (int c = FIRST_CHAR; c <= LAST_CHAR; c++)
+	{
+		Glyph &entry = glyphs[c - FIRST_CHAR];
+		int minX, maxX, minY, maxY;
+		if (TTF_GlyphMetrics(font, Uint16(c), &minX, &maxX, &minY, &maxY, &entry.advance) != 0)
+			entry.advance = 0;
+
+		SDL_Surface *surface = c == ' ' ? nullptr : TTF_RenderGlyph_Blended(font, Uint16(c), white);
+		int w = surface ? surface->w : 0;
+		int h = surface ? surface->h : 0;
+		if (x + w > ATLAS_WIDTH)
+		{
+			x = 0;
+			y += rowHeight + 1;
+			rowHeight = 0;
+		}
+		entry.source = {x, y, w, h};
+		x += w + 1;
+		rowHeight = std::max(rowHeight, h);
+		surfaces[c - FIRST_CHAR] = surface;
+	}
+	atlasHeight = std::max(1, y + rowHeight);
+
+	SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, atlasHeight, 32, SDL_PIXELFORMAT_RGBA32);
+	for (int i = 0; i <= LAST_CHAR - FIRST_CHAR; i++)
+	{
+		if (!surfaces[i])
+			continue;
+		if (atlas)
+		{
+			// Copy the coverage into the alpha channel instead of blending it onto the empty atlas
+			SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+			SDL_Rect destination = glyphs[i].source;
+			SDL_BlitSurface(surfaces[i], nullptr, atlas, &destination);
+		}
+		SDL_FreeSurface(surfaces[i]);
+	}
+	if (!atlas)
+	{
+		std::cerr << "Failed to create the glyph atlas: " << SDL_GetError() << std::endl;
+		return false;
+	}
+
+	texture = SDL_CreateTextureFromSurface(renderer, atlas);
+	SDL_FreeSurface(atlas);
+	if (!texture)
+	{
+		std::cerr << "Failed to create the glyph atlas texture: " << SDL_GetError() << std::endl;
+		return false;
+	}
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	textureCount++;
+	return true;
+}
+
+void GlyphAtlas::release()
+{
+	if (texture)
+		SDL_DestroyTexture(texture);
+	texture = nullptr;
+	font = nullptr;
+	vertices.clear();
+	indices.clear();
+}
+
+const GlyphAtlas::Glyph &GlyphAtlas::glyph(char c) const
+{
+	int code = static_cast<unsigned char>(c);
+	if (code < FIRST_CHAR || code > LAST_CHAR)
+		code = '?';
+	return glyphs[code - FIRST_CHAR];
+}
+
+int GlyphAtlas::kerning(char previous, char c) const
+{
+	return previous ? TTF_GetFontKerningSizeGlyphs(font, Uint16(static_cast<unsigned char>(previous)), Uint16(static_cast<unsigned char>(c))) : 0;
+}
+
+int GlyphAtlas::textWidth(const std::string &text) const
+{
+	if (!texture)
+		return 0;
+	int width = 0;
+	char previous = 0;
+	for (char c : text)
+	{
+		width += kerning(previous, c) + glyph(c).advance;
+		previous = c;
+	}
+	return width;
+}
+
+void GlyphAtlas::add(const std::string &text, int x, int y, SDL_Color color, bool centeredX, bool centeredY)
+{
+	if (!texture)
+		return;
+	if (centeredX)
+		x -= textWidth(text) / 2;
+	if (centeredY)
+		y -= height / 2;
+
+	const float u = 1.0f / ATLAS_WIDTH;
+	const float v = 1.0f / atlasHeight;
+	char previous = 0;
+	for (char c : text)
+	{
+		x += kerning(previous, c);
+		previous = c;
+		const Glyph &entry = glyph(c);
+		if (entry.source.w > 0)
+		{
+			float left = float(x), top = float(y);
+			float right = left + entry.source.w, bottom = top + entry.source.h;
+			float s0 = entry.source.x * u, t0 = entry.source.y * v;
+			float s1 = (entry.source.x + entry.source.w) * u, t1 = (entry.source.y + entry.source.h) * v;
+
+			int first = int(vertices.size());
+			vertices.push_back({{left, top}, color, {s0, t0}});
+			vertices.push_back({{right, top}, color, {s1, t0}});
+			vertices.push_back({{left, bottom}, color, {s0, t1}});
+			vertices.push_back({{right, bottom}, color, {s1, t1}});
+			for (int corner : {0, 1, 2, 2, 1, 3})
+				indices.push_back(first + corner);
+			glyphCount++;
+		}
+		x += entry.advance;
+	}
+}
+
+void GlyphAtlas::flush(SDL_Renderer *renderer)
+{
+	if (indices.empty())
+		return;
+	SDL_RenderGeometry(renderer, texture, vertices.data(), int(vertices.size()), indices.data(), int(indices.size()));
+	drawCallCount++;
+	vertices.clear();
+	indices.clear();
+}
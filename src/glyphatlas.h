@@ -0,0 +1,65 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Every printable ASCII glyph of a font rendered once into a single texture. Text is laid out
+// from the glyph advances (and kerning) into textured quads that add() queues and flush() draws
+// with one SDL_RenderGeometry call, so drawing text creates no surface or texture after build()
+class GlyphAtlas
+{
+public:
+	GlyphAtlas() = default;
+	GlyphAtlas(const GlyphAtlas &) = delete;
+	GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+	~GlyphAtlas() { release(); }
+
+	// Renders the glyphs of font into the atlas texture. The font must stay open while text is drawn
+	bool build(SDL_Renderer *renderer, TTF_Font *font);
+	void release();
+
+	// Queues text with its top left corner at x, y, or its center on the axes asked for.
+	// Characters outside printable ASCII are drawn as '?'
+	void add(const std::string &text, int x, int y, SDL_Color color, bool centeredX = false, bool centeredY = false);
+	// Draws the text queued since the last flush
+	void flush(SDL_Renderer *renderer);
+
+	int textWidth(const std::string &text) const;
+	int lineHeight() const { return height; }
+
+	// Textures created over the atlas' life (one per build), and draw calls and glyphs drawn
+	int texturesCreated() const { return textureCount; }
+	uint64_t drawCalls() const { return drawCallCount; }
+	uint64_t glyphsDrawn() const { return glyphCount; }
+
+private:
+	static const int FIRST_CHAR = 32;
+	static const int LAST_CHAR = 126;
+	static const int ATLAS_WIDTH = 512;
+
+	struct Glyph
+	{
+		SDL_Rect source;
+		int advance;
+	};
+
+	const Glyph &glyph(char c) const;
+	int kerning(char previous, char c) const;
+
+	TTF_Font *font = nullptr;
+	SDL_Texture *texture = nullptr;
+	int atlasHeight = 0;
+	int height = 0;
+	Glyph glyphs[LAST_CHAR - FIRST_CHAR + 1];
+
+	// Reused between flushes so steady state drawing does not allocate either
+	std::vector<SDL_Vertex> vertices;
+	std::vector<int> indices;
+
+	int textureCount = 0;
+	uint64_t drawCallCount = 0;
+	uint64_t glyphCount = 0;
+};
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -5,7 +7,10 @@
 #include <string>
 #include <vector>
 
-const int LOG_VECTOR_SIZE = 20;
+const int LOG_CAPACITY = 1024;
+const int LOG_LINE_HEIGHT = 20;
+const int LOG_PADDING = 10;
+const int LOG_SCROLL_LINES = 3;
 const int SIDE_PANEL_WIDTH = 400;
 const int BOARD_WIDTH = 992;
 const int BOARD_HEIGHT = 992;
@@ -238,13 +243,16 @@ bool isValidMove3(int board[8][8], int startX, int startY, int endX, int endY)
 	return true;
 }
 
-void movePiece(int board[8][8], int startX, int startY, int endX, int endY)
+// Function to move a piece, false when the move is not valid and nothing moved
+bool movePiece(int board[8][8], int startX, int startY, int endX, int endY)
 {
 	if (isValidMove(board, startX, startY, endX, endY))
 	{
 		board[endX][endY] = board[startX][startY];
 		board[startX][startY] = 0;
+		return true;
 	}
+	return false;
 }
 
 void highlightMoves(SDL_Renderer *renderer, int board[8][8], int startX, int startY)
@@ -267,66 +275,148 @@ void highlightMoves(SDL_Renderer *renderer, int board[8][8], int startX, int sta
 	}
 }
 
-void drawLogSidePanel(SDL_Renderer *renderer, TTF_Font *font, const std::vector<std::string> &log)
+// One line of the side panel log, rendered into a texture once when it is added
+struct LogEntry
+{
+	std::string text;
+	SDL_Texture *texture = nullptr;
+	int width = 0;
+	int height = 0;
+};
+
+// The last LOG_CAPACITY moves and events, oldest first from entries[first]. Past the capacity a
+// new entry takes the place of the oldest, so entries are never moved and the textures of the
+// others are kept. scroll is how far in pixels the view is scrolled back from the newest line, it
+// eases toward targetScroll every frame
+struct LogPanel
+{
+	LogEntry entries[LOG_CAPACITY];
+	int first = 0;
+	int count = 0;
+	float scroll = 0;
+	float targetScroll = 0;
+};
+
+// Function to find how far back the log can be scrolled: until its oldest line is at the top
+float maxLogScroll(const LogPanel &log)
+{
+	return float(std::max(0, log.count * LOG_LINE_HEIGHT - (SCREEN_HEIGHT - 2 * LOG_PADDING)));
+}
+
+// Function to scroll the log lines back (positive) or forward, the view gets there over a few frames
+void scrollLog(LogPanel &log, int lines)
+{
+	log.targetScroll = std::max(0.0f, std::min(log.targetScroll + float(lines * LOG_LINE_HEIGHT), maxLogScroll(log)));
+}
+
+// Function to move the view a step closer to where it is scrolled to
+void animateLogScroll(LogPanel &log)
+{
+	float distance = log.targetScroll - log.scroll;
+	log.scroll = std::fabs(distance) < 0.5f ? log.targetScroll : log.scroll + distance * 0.3f;
+}
+
+// Function to draw the lines of the log in view, newest at the bottom. Only the lines in view are
+// touched and each is one copy of its texture
+void drawLogSidePanel(SDL_Renderer *renderer, const LogPanel &log)
 {
 	// Draw the side panel
 	SDL_Rect sidePanel = {BOARD_WIDTH, 0, SIDE_PANEL_WIDTH, SCREEN_HEIGHT};
-	// SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black
-	// SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // white
 	SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255); // Dark grey background
 	SDL_RenderFillRect(renderer, &sidePanel);
 
-	// Dummy text rendering placeholder (replace with SDL_ttf for real text rendering)
-	SDL_Color color = {255, 255, 255}; // black
-	// SDL_Color color = {0, 0, 0}; // white
-	int yOffset = 10;
-	for (const auto &message : log)
-	{
-		// Text rendering would go here using SDL_ttf library
-		std::cout << "Log: " << message << std::endl; 
-		
-		int y = 0;
-		for (const std::string &message : log)
-		{
-			SDL_Surface *surface = TTF_RenderText_Blended(font, message.c_str(), color);
-			if (surface == nullptr)
-			{
-				std::cerr << "TTF_RenderText_Solid Error: " << TTF_GetError() << std::endl;
-				SDL_Log("TTF_RenderText_Solid Error: %s", TTF_GetError());				
-				continue;
-			}
-
-			SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-			if (texture == nullptr)
-			{
-				std::cerr << "SDL_CreateTextureFromSurface Error: " << SDL_GetError() << std::endl;
-				SDL_Log("SDL_CreateTextureFromSurface Error: %s", SDL_GetError());
-				SDL_FreeSurface(surface);				
-				continue;
-			}
+	// The bottom of the newest line, lines before it stack upwards
+	float bottom = SCREEN_HEIGHT - LOG_PADDING + log.scroll;
+	int firstVisible = std::max(0, log.count - 1 - int(bottom / LOG_LINE_HEIGHT));
 
-			SDL_Rect rect = {SCREEN_WIDTH + 10, yOffset, surface->w, surface->h};
-			SDL_RenderCopy(renderer, texture, NULL, &rect);
+	SDL_RenderSetClipRect(renderer, &sidePanel);
+	for (int i = firstVisible; i < log.count; i++)
+	{
+		int y = int(std::lround(bottom)) - (log.count - i) * LOG_LINE_HEIGHT;
+		if (y >= SCREEN_HEIGHT)
+			break;
+		const LogEntry &entry = log.entries[(log.first + i) % LOG_CAPACITY];
+		if (!entry.texture)
+			continue;
+		SDL_Rect rect = {BOARD_WIDTH + LOG_PADDING, y, entry.width, entry.height};
+		SDL_RenderCopy(renderer, entry.texture, NULL, &rect);
+	}
+	SDL_RenderSetClipRect(renderer, NULL);
+}
 
-			SDL_FreeSurface(surface);
-			SDL_DestroyTexture(texture);
+// Function to add a line to the log, rendering its texture now so drawing never has to
+void logEvent(SDL_Renderer *renderer, TTF_Font *font, LogPanel &log, const std::string &message)
+{
+	LogEntry *entry;
+	if (log.count == LOG_CAPACITY)
+	{
+		entry = &log.entries[log.first];
+		log.first = (log.first + 1) % LOG_CAPACITY;
+	}
+	else
+		entry = &log.entries[(log.first + log.count++) % LOG_CAPACITY];
+
+	if (entry->texture)
+		SDL_DestroyTexture(entry->texture);
+	entry->text = message;
+	entry->texture = nullptr;
+	entry->width = entry->height = 0;
+
+	SDL_Color color = {255, 255, 255, 255};
+	SDL_Surface *surface = message.empty() ? nullptr : TTF_RenderText_Blended(font, message.c_str(), color);
+	if (surface)
+	{
+		entry->texture = SDL_CreateTextureFromSurface(renderer, surface);
+		entry->width = surface->w;
+		entry->height = surface->h;
+		SDL_FreeSurface(surface);
+		if (!entry->texture)
+			std::cerr << "SDL_CreateTextureFromSurface Error: " << SDL_GetError() << std::endl;
+	}
+	else if (!message.empty())
+		std::cerr << "TTF_RenderText_Blended Error: " << TTF_GetError() << std::endl;
 
-			// y += 20;
-			yOffset += 20;
-		}
+	// A view scrolled back keeps showing the same lines, one at the bottom keeps following
+	if (log.targetScroll > 0)
+	{
+		log.scroll += LOG_LINE_HEIGHT;
+		log.targetScroll = std::min(log.targetScroll + LOG_LINE_HEIGHT, maxLogScroll(log));
+		log.scroll = std::min(log.scroll, maxLogScroll(log));
 	}
 }
 
-void logEvent(std::vector<std::string> &log, const std::string &message)
+void clearLog(LogPanel &log)
 {
-	if (log.size() > LOG_VECTOR_SIZE)
+	for (LogEntry &entry : log.entries)
 	{
-		log.erase(log.begin());
+		if (entry.texture)
+			SDL_DestroyTexture(entry.texture);
+		entry = LogEntry();
 	}
-	log.push_back(message);
+	log.first = log.count = 0;
+	log.scroll = log.targetScroll = 0;
+}
+
+// Function to check whether a piece code belongs to the side to move (1 to 6 black, 7 to 12 white)
+bool isOwnPiece(int piece, bool whiteToMove)
+{
+	return piece != 0 && (piece > 6) == whiteToMove;
 }
 
-bool InitLibraries(SDL_Renderer *&renderer, SDL_Window *&window, TTF_Font *&font, std::vector<std::string> &log)
+// Function to write a move in algebraic notation: piece letter, x for captures, destination. The
+// board here knows no rules, so there is no disambiguation, check or castling
+std::string moveNotation(int board[8][8], int startX, int startY, int endX, int endY)
+{
+	const char *letters = " PRNBQK"; // indexed by PieceType
+	int type = (board[startX][startY] - 1) % 6 + 1;
+	bool capture = board[endX][endY] != 0;
+	std::string target = {char('a' + endY), char('8' - endX)};
+	if (type == PAWN)
+		return capture ? std::string(1, char('a' + startY)) + "x" + target : target;
+	return std::string(1, letters[type]) + (capture ? "x" : "") + target;
+}
+
+bool InitLibraries(SDL_Renderer *&renderer, SDL_Window *&window, TTF_Font *&font, LogPanel &log)
 {
 	if (SDL_Init(SDL_INIT_VIDEO) != 0)
 	{
@@ -381,7 +471,7 @@ bool InitLibraries(SDL_Renderer *&renderer, SDL_Window *&window, TTF_Font *&font
 		return false;
 	}
 
-	logEvent(log, "Initialized libraries successfully");
+	logEvent(renderer, font, log, "Initialized libraries successfully");
 
 	return true;
 }
@@ -390,7 +480,7 @@ int main(int argc, char *argv[])
 {
 	SDL_Window *window = nullptr;
 	SDL_Renderer *renderer = nullptr;
-	std::vector<std::string> log = {};
+	LogPanel log;
 	TTF_Font *font = nullptr;
 
 	if (!InitLibraries(renderer, window, font, log))
@@ -430,6 +520,8 @@ int main(int argc, char *argv[])
 	SDL_Event event;
 	bool pieceSelected = false;
 	int selectedX = -1, selectedY = -1;
+	bool whiteToMove = true;
+	int moveNumber = 1;
 
 	while (running)
 	{
@@ -458,6 +550,37 @@ int main(int argc, char *argv[])
 			{
 				running = false;
 			}
+			else if (event.type == SDL_MOUSEWHEEL && mouseX >= BOARD_WIDTH)
+			{
+				// Wheel up goes back in the game
+				scrollLog(log, event.wheel.y * LOG_SCROLL_LINES);
+			}
+			else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT && event.button.x < BOARD_WIDTH)
+			{
+				// Click a piece of the side to move, then the square it goes to
+				int row = event.button.y / SQUARE_SIZE;
+				int col = event.button.x / SQUARE_SIZE;
+				if (isOwnPiece(board[row][col], whiteToMove))
+				{
+					pieceSelected = true;
+					selectedX = row;
+					selectedY = col;
+				}
+				else if (pieceSelected)
+				{
+					std::string notation = moveNotation(board, selectedX, selectedY, row, col);
+					if (movePiece(board, selectedX, selectedY, row, col))
+					{
+						logEvent(renderer, font, log, std::to_string(moveNumber) + (whiteToMove ? ". " : "... ") + notation);
+						if (!whiteToMove)
+							moveNumber++;
+						whiteToMove = !whiteToMove;
+					}
+					pieceSelected = false;
+					selectedX = -1;
+					selectedY = -1;
+				}
+			}
 			// Handle mouse click events for moving pieces
 			// if (!pieceSelected && board[startX][startY] != 0)
 				// {
@@ -500,7 +623,8 @@ int main(int argc, char *argv[])
 
 		drawBoard(renderer);
 		renderPiecesInBoard(renderer, pieces, board);
-		drawLogSidePanel(renderer, font, log);
+		animateLogScroll(log);
+		drawLogSidePanel(renderer, log);
 
 		// Create the players
 		// Create the game loop
@@ -515,9 +639,6 @@ int main(int argc, char *argv[])
 
 		// renderPiecesInBoard(renderer, pieces, board);
 
-		// clear log
-		log.clear();
-
 		SDL_RenderPresent(renderer);
 		SDL_Delay(16); // 60FPS
 	}
@@ -526,6 +647,7 @@ int main(int argc, char *argv[])
 	{
 		SDL_DestroyTexture(pieces[i]);
 	}
+	clearLog(log);
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	TTF_CloseFont(font);
@@ -0,0 +1,98 @@
+// Builds an opening book from PGN games. Every move played in the first plies of a game is
+// entered for the position it was played in, scored 2 for a win, 1 for a draw and 0 for a loss
+// of the side that played it, and moves that never scored are left out
+//   makebook [-d plies] [-m minGames] games.pgn book.bin
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "book.h"
+#include "pgn.h"
+#include "position.h"
+
+struct MoveStats
+{
+	uint64_t score = 0;
+	int games = 0;
+};
+
+int main(int argc, char *argv[])
+{
+	int maxPlies = 20;
+	int minGames = 1;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-d" && i + 1 < argc)
+			maxPlies = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-m" && i + 1 < argc)
+			minGames = std::max(1, std::atoi(argv[++i]));
+		else
+			files.push_back(arg);
+	}
+	if (files.size() != 2)
+	{
+		std::cerr << "usage: makebook [-d plies] [-m minGames] games.pgn book.bin" << std::endl;
+		return 1;
+	}
+
+	initBitboards();
+	std::ifstream in(files[0]);
+	if (!in)
+	{
+		std::cerr << "cannot read " << files[0] << std::endl;
+		return 1;
+	}
+
+	std::map<std::pair<uint64_t, uint16_t>, MoveStats> stats;
+	PgnGame game;
+	int gameCount = 0;
+	while (readPgnGame(in, game))
+	{
+		if (game.result != "1-0" && game.result != "0-1" && game.result != "1/2-1/2")
+			continue;
+		gameCount++;
+
+		Position position = game.start;
+		int plies = std::min(int(game.moves.size()), maxPlies);
+		for (int ply = 0; ply < plies; ply++)
+		{
+			Move move = game.moves[ply];
+			bool won = game.result == (position.sideToMove() == WHITE ? "1-0" : "0-1");
+			MoveStats &entry = stats[{polyglotKey(position), encodeBookMove(move)}];
+			entry.score += game.result == "1/2-1/2" ? 1 : won ? 2 : 0;
+			entry.games++;
+
+			UndoInfo undo;
+			position.makeMove(move, undo);
+		}
+	}
+
+	// Weights are 16 bit, scale everything down together if the busiest move does not fit
+	uint64_t maxScore = 1;
+	for (const auto &item : stats)
+		maxScore = std::max(maxScore, item.second.score);
+	uint64_t divisor = (maxScore + 65534) / 65535;
+
+	std::vector<BookEntry> entries;
+	for (const auto &item : stats)
+	{
+		uint64_t weight = item.second.score / divisor;
+		if (item.second.games >= minGames && weight > 0)
+			entries.push_back({item.first.first, item.first.second, uint16_t(weight), 0});
+	}
+
+	if (!writeBook(files[1], entries))
+	{
+		std::cerr << "cannot write " << files[1] << std::endl;
+		return 1;
+	}
+	std::cout << gameCount << " games, " << entries.size() << " book entries written to " << files[1] << std::endl;
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string &path, bool randomAccess)
+{
+	close();
+	void *mapped = nullptr;
+	size_t fileSize = 0;
+
+#ifdef _WIN32
+	(void)randomAccess;
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER sizeInfo;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &sizeInfo) && sizeInfo.QuadPart > 0)
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping)
+		mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!mapped)
+	{
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileSize = size_t(sizeInfo.QuadPart);
+	fileHandle = file;
+	mappingHandle = mapping;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat status;
+	if (fstat(fd, &status) == 0 && status.st_size > 0)
+	{
+		fileSize = size_t(status.st_size);
+		mapped = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+		if (mapped == MAP_FAILED)
+			mapped = nullptr;
+	}
+	// The mapping keeps the file alive on its own
+	::close(fd);
+	if (!mapped)
+		return false;
+	if (randomAccess)
+		madvise(mapped, fileSize, MADV_RANDOM);
+#endif
+
+	bytes = static_cast<const unsigned char *>(mapped);
+	length = fileSize;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (!bytes)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(bytes);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	fileHandle = mappingHandle = nullptr;
+#else
+	munmap(const_cast<unsigned char *>(bytes), length);
+#endif
+	bytes = nullptr;
+	length = 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read only into memory. Opening reads nothing, pages come in as they are touched
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	~MappedFile() { close(); }
+
+	// Returns false and stays closed when the file is missing or empty. randomAccess turns off
+	// read ahead for files probed at scattered offsets
+	bool open(const std::string &path, bool randomAccess = true);
+	void close();
+	bool isOpen() const { return bytes != nullptr; }
+
+	const unsigned char *data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char *bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#endif
+};
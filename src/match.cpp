@@ -0,0 +1,698 @@
+// Headless self-play match: plays two UCI engines (two builds of ./uci, usually) against each other,
+// many games at once, and stops early once a sequential probability ratio test decides whether the
+// first engine is stronger. Every game is judged with the same Position code the game uses.
+//   match [-c concurrency] [-g games] [-t movetimeMs] [-n nodes] [-H hashMB] [-o openings.epd|.pgn]
+//         [-p games.pgn] [-s elo0 elo1 [alpha beta]] engine1 engine2
+// POSIX only: engines run as child processes talking through pipes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cctype>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "pgn.h"
+#include "position.h"
+
+typedef std::chrono::steady_clock Clock;
+
+const int HANDSHAKE_TIMEOUT_MS = 10000;
+const int NODES_MOVE_TIMEOUT_MS = 60000;
+const int PGN_LINE_WIDTH = 80;
+
+// A UCI engine running as a child process
+class EngineProcess
+{
+public:
+	~EngineProcess() { close(); }
+
+	bool open(const std::string &command);
+	// Asks the engine to quit, and kills it if it does not
+	void close();
+	bool isOpen() const { return pid > 0; }
+
+	bool send(const std::string &line);
+	// Reads one line, false when the deadline passes first or the engine is gone
+	bool readLine(std::string &line, Clock::time_point deadline);
+	// Skips lines until one starts with prefix
+	bool waitFor(const std::string &prefix, std::string &line, Clock::time_point deadline);
+
+private:
+	pid_t pid = -1;
+	int toEngine = -1;
+	int fromEngine = -1;
+	std::string buffer;
+};
+
+// Serialises pipe creation and fork, so a child started by one game never inherits the pipes of
+// another game's engine before they are marked close-on-exec
+static std::mutex spawnMutex;
+
+bool EngineProcess::open(const std::string &command)
+{
+	close();
+	std::lock_guard<std::mutex> lock(spawnMutex);
+
+	int input[2], output[2];
+	if (pipe(input) != 0)
+		return false;
+	if (pipe(output) != 0)
+	{
+		::close(input[0]);
+		::close(input[1]);
+		return false;
+	}
+	for (int fd : {input[0], input[1], output[0], output[1]})
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	pid = fork();
+	if (pid == 0)
+	{
+		// Only async-signal-safe calls between fork and exec
+		dup2(input[0], STDIN_FILENO);
+		dup2(output[1], STDOUT_FILENO);
+		execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
+		_exit(127);
+	}
+
+	::close(input[0]);
+	::close(output[1]);
+	if (pid < 0)
+	{
+		::close(input[1]);
+		::close(output[0]);
+		return false;
+	}
+	toEngine = input[1];
+	fromEngine = output[0];
+	buffer.clear();
+	return true;
+}
+
+void EngineProcess::close()
+{
+	if (pid <= 0)
+		return;
+
+	send("quit");
+	::close(toEngine);
+	::close(fromEngine);
+	toEngine = fromEngine = -1;
+
+	auto deadline = Clock::now() + std::chrono::milliseconds(500);
+	while (waitpid(pid, nullptr, WNOHANG) == 0)
+	{
+		if (Clock::now() > deadline)
+		{
+			kill(pid, SIGKILL);
+			waitpid(pid, nullptr, 0);
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	pid = -1;
+}
+
+bool EngineProcess::send(const std::string &line)
+{
+	if (toEngine < 0)
+		return false;
+	std::string data = line + '\n';
+	size_t written = 0;
+	while (written < data.size())
+	{
+		ssize_t count = write(toEngine, data.data() + written, data.size() - written);
+		if (count <= 0)
+			return false;
+		written += size_t(count);
+	}
+	return true;
+}
+
+bool EngineProcess::readLine(std::string &line, Clock::time_point deadline)
+{
+	while (true)
+	{
+		size_t end = buffer.find('\n');
+		if (end != std::string::npos)
+		{
+			line = buffer.substr(0, end);
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			buffer.erase(0, end + 1);
+			return true;
+		}
+
+		int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+		if (fromEngine < 0 || remaining <= 0)
+			return false;
+
+		pollfd request = {fromEngine, POLLIN, 0};
+		if (poll(&request, 1, int(std::min<int64_t>(remaining, 1000))) <= 0)
+			continue;
+
+		char chunk[4096];
+		ssize_t count = read(fromEngine, chunk, sizeof(chunk));
+		if (count <= 0)
+			return false;
+		buffer.append(chunk, size_t(count));
+	}
+}
+
+bool EngineProcess::waitFor(const std::string &prefix, std::string &line, Clock::time_point deadline)
+{
+	while (readLine(line, deadline))
+	{
+		if (line.compare(0, prefix.size(), prefix) == 0)
+			return true;
+	}
+	return false;
+}
+
+struct MatchOptions
+{
+	std::string commands[2];
+	std::string names[2];
+	int concurrency = 1;
+	int games = 100;
+	int64_t moveTime = 0;
+	uint64_t nodes = 0;
+	int hashMb = 16;
+	std::string openingsFile;
+	std::string pgnFile;
+
+	// SPRT on the Elo of engine1 over engine2: H0 elo = elo0 against H1 elo = elo1
+	bool sprt = false;
+	double elo0 = 0, elo1 = 5, alpha = 0.05, beta = 0.05;
+};
+
+enum GameResult
+{
+	WHITE_WINS,
+	BLACK_WINS,
+	DRAWN
+};
+
+// Result from engine1's point of view. A sequential test looks at these after every game
+struct MatchStats
+{
+	int wins = 0;
+	int losses = 0;
+	int draws = 0;
+
+	int games() const { return wins + losses + draws; }
+	double score() const { return games() ? (wins + 0.5 * draws) / games() : 0.5; }
+
+	// Variance of a single game's score
+	double variance() const
+	{
+		double s = score();
+		return games() ? (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / games() : 0;
+	}
+};
+
+static double scoreToElo(double score)
+{
+	score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+	return -400 * std::log10(1 / score - 1);
+}
+
+static double eloToScore(double elo)
+{
+	return 1 / (1 + std::pow(10, -elo / 400));
+}
+
+// Function for the generalised SPRT log likelihood ratio of the game scores so far (normal
+// approximation of the trinomial win/draw/loss model, logistic Elo)
+static double logLikelihoodRatio(const MatchStats &stats, double elo0, double elo1)
+{
+	double variance = stats.variance();
+	if (stats.games() == 0 || variance <= 0)
+		return 0;
+	double s0 = eloToScore(elo0), s1 = eloToScore(elo1);
+	return (s1 - s0) * (2 * stats.score() - s0 - s1) * stats.games() / (2 * variance);
+}
+
+// A start position, with its FEN for the engines and the PGN header
+struct Opening
+{
+	Position position;
+	std::string fen;
+};
+
+// Function to read openings: one position per line for EPD, the position at the end of every game for PGN
+static std::vector<Opening> loadOpenings(const std::string &path)
+{
+	std::vector<Opening> openings;
+	std::ifstream file(path);
+	if (!file)
+		return openings;
+
+	bool isPgn = path.size() >= 4 && path.compare(path.size() - 4, 4, ".pgn") == 0;
+	std::string line;
+
+	if (!isPgn)
+	{
+		while (std::getline(file, line))
+		{
+			Opening opening;
+			if (opening.position.setFromFen(line))
+			{
+				opening.fen = opening.position.fen();
+				openings.push_back(opening);
+			}
+		}
+		return openings;
+	}
+
+	PgnGame game;
+	while (readPgnGame(file, game))
+	{
+		Opening opening;
+		opening.position = game.start;
+		for (Move move : game.moves)
+		{
+			UndoInfo undo;
+			opening.position.makeMove(move, undo);
+		}
+		opening.fen = opening.position.fen();
+		openings.push_back(opening);
+	}
+	return openings;
+}
+
+// One finished game, ready for the statistics and the PGN file
+struct GameRecord
+{
+	int round = 0;
+	int white = 0; // engine index
+	std::string startFen;
+	std::vector<std::string> sanMoves;
+	int firstMoveNumber = 1;
+	bool blackStarts = false;
+	GameResult result = DRAWN;
+	std::string termination; // PGN Termination tag
+	std::string reason;		 // closing comment
+};
+
+// Function to decide a finished game: mate, stalemate, fifty moves, threefold repetition or bare kings
+static bool isGameOver(const Position &position, const std::vector<uint64_t> &keys, GameRecord &record)
+{
+	MoveList moves;
+	position.generateLegalMoves(moves);
+	if (moves.size() == 0)
+	{
+		record.termination = "normal";
+		if (position.inCheck())
+		{
+			record.result = position.sideToMove() == WHITE ? BLACK_WINS : WHITE_WINS;
+			record.reason = position.sideToMove() == WHITE ? "Black mates" : "White mates";
+		}
+		else
+		{
+			record.result = DRAWN;
+			record.reason = "Draw by stalemate";
+		}
+		return true;
+	}
+
+	record.result = DRAWN;
+	record.termination = "normal";
+	if (position.halfmoves() >= 100)
+	{
+		record.reason = "Draw by fifty moves rule";
+		return true;
+	}
+	if (position.isInsufficientMaterial())
+	{
+		record.reason = "Draw by insufficient mating material";
+		return true;
+	}
+
+	int repetitions = 0;
+	int last = int(keys.size()) - 1;
+	for (int i = last - 1; i >= 0 && i >= last - position.halfmoves(); i -= 2)
+		repetitions += keys[i] == position.key();
+	if (repetitions >= 2)
+	{
+		record.reason = "Draw by threefold repetition";
+		return true;
+	}
+	return false;
+}
+
+// Function to start an engine and bring it to the point where it accepts positions
+static bool startEngine(EngineProcess &engine, const MatchOptions &options, int index)
+{
+	std::string line;
+	auto deadline = Clock::now() + std::chrono::milliseconds(HANDSHAKE_TIMEOUT_MS);
+	if (!engine.open(options.commands[index]) || !engine.send("uci") || !engine.waitFor("uciok", line, deadline))
+		return false;
+	engine.send("setoption name Hash value " + std::to_string(options.hashMb));
+	engine.send("setoption name Threads value 1");
+	return true;
+}
+
+static bool newGame(EngineProcess &engine, const MatchOptions &options, int index)
+{
+	std::string line;
+	auto deadline = Clock::now() + std::chrono::milliseconds(HANDSHAKE_TIMEOUT_MS);
+	if (engine.isOpen() && engine.send("ucinewgame") && engine.send("isready") && engine.waitFor("readyok", line, deadline))
+		return true;
+	return startEngine(engine, options, index) && engine.send("ucinewgame") && engine.send("isready") && engine.waitFor("readyok", line, deadline);
+}
+
+// Function to play one game. engines[0] is engine1 whichever color it has
+static GameRecord playGame(EngineProcess engines[2], const MatchOptions &options, const Opening &opening, int round, int white)
+{
+	GameRecord record;
+	record.round = round;
+	record.white = white;
+	record.startFen = opening.fen;
+	record.firstMoveNumber = opening.position.fullmoves();
+	record.blackStarts = opening.position.sideToMove() == BLACK;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (!newGame(engines[i], options, i))
+		{
+			bool whiteFailed = i == white;
+			record.result = whiteFailed ? BLACK_WINS : WHITE_WINS;
+			record.termination = "abandoned";
+			record.reason = std::string(whiteFailed ? "White" : "Black") + " engine failed to start";
+			return record;
+		}
+	}
+
+	std::string goCommand = "go";
+	if (options.nodes)
+		goCommand += " nodes " + std::to_string(options.nodes);
+	if (options.moveTime)
+		goCommand += " movetime " + std::to_string(options.moveTime);
+	// Generous: a busy machine must not turn into time losses, only a hung engine should
+	int64_t timeout = options.moveTime ? options.moveTime * 2 + 1000 : NODES_MOVE_TIMEOUT_MS;
+
+	Position position = opening.position;
+	std::vector<uint64_t> keys;
+	std::string positionCommand = "position fen " + opening.fen + " moves";
+
+	while (!isGameOver(position, keys, record))
+	{
+		Color us = position.sideToMove();
+		int mover = us == WHITE ? white : 1 - white;
+		EngineProcess &engine = engines[mover];
+		const char *side = us == WHITE ? "White" : "Black";
+		record.result = us == WHITE ? BLACK_WINS : WHITE_WINS;
+
+		std::string line;
+		auto deadline = Clock::now() + std::chrono::milliseconds(timeout);
+		if (!engine.send(positionCommand) || !engine.send(goCommand) || !engine.waitFor("bestmove", line, deadline))
+		{
+			// Hung or crashed, start it afresh for the next game
+			engine.close();
+			record.termination = "time forfeit";
+			record.reason = std::string(side) + " loses on time";
+			return record;
+		}
+
+		std::istringstream stream(line);
+		std::string token, text;
+		stream >> token >> text;
+		Move move = moveFromUci(position, text);
+		if (move == MOVE_NONE)
+		{
+			record.termination = "illegal move";
+			record.reason = std::string(side) + " makes an illegal move: " + text;
+			return record;
+		}
+
+		record.sanMoves.push_back(moveToSan(position, move));
+		positionCommand += " " + text;
+		keys.push_back(position.key());
+		UndoInfo undo;
+		position.makeMove(move, undo);
+	}
+	return record;
+}
+
+// Function to write a game in export format: tags, then movetext wrapped to PGN_LINE_WIDTH
+static std::string formatPgn(const GameRecord &record, const MatchOptions &options)
+{
+	static const char *RESULTS[3] = {"1-0", "0-1", "1/2-1/2"};
+	const char *result = RESULTS[record.result];
+
+	char date[16];
+	std::time_t now = std::time(nullptr);
+	std::strftime(date, sizeof(date), "%Y.%m.%d", std::localtime(&now));
+
+	std::ostringstream pgn;
+	pgn << "[Event \"" << options.names[0] << " vs " << options.names[1] << "\"]\n";
+	pgn << "[Site \"?\"]\n";
+	pgn << "[Date \"" << date << "\"]\n";
+	pgn << "[Round \"" << record.round << "\"]\n";
+	pgn << "[White \"" << options.names[record.white] << "\"]\n";
+	pgn << "[Black \"" << options.names[1 - record.white] << "\"]\n";
+	pgn << "[Result \"" << result << "\"]\n";
+	if (record.startFen != START_FEN)
+		pgn << "[SetUp \"1\"]\n[FEN \"" << record.startFen << "\"]\n";
+	pgn << "[PlyCount \"" << record.sanMoves.size() << "\"]\n";
+	pgn << "[Termination \"" << record.termination << "\"]\n\n";
+
+	std::vector<std::string> tokens;
+	int moveNumber = record.firstMoveNumber;
+	bool whiteToMove = !record.blackStarts;
+	for (size_t i = 0; i < record.sanMoves.size(); i++)
+	{
+		if (whiteToMove)
+			tokens.push_back(std::to_string(moveNumber) + ".");
+		else if (i == 0)
+			tokens.push_back(std::to_string(moveNumber) + "...");
+		tokens.push_back(record.sanMoves[i]);
+		if (!whiteToMove)
+			moveNumber++;
+		whiteToMove = !whiteToMove;
+	}
+	tokens.push_back("{" + record.reason + "}");
+	tokens.push_back(result);
+
+	size_t width = 0;
+	for (const std::string &token : tokens)
+	{
+		if (width > 0 && width + 1 + token.size() > PGN_LINE_WIDTH)
+		{
+			pgn << '\n';
+			width = 0;
+		}
+		else if (width > 0)
+		{
+			pgn << ' ';
+			width++;
+		}
+		pgn << token;
+		width += token.size();
+	}
+	pgn << "\n\n";
+	return pgn.str();
+}
+
+// Shared by the game threads, everything but the counter under the mutex
+struct Match
+{
+	MatchOptions options;
+	std::vector<Opening> openings;
+	std::atomic<int> nextGame{0};
+	std::atomic<bool> decided{false};
+
+	std::mutex mutex;
+	MatchStats stats;
+	std::ofstream pgn;
+};
+
+// Function to count a finished game, stream it to the PGN file and check the SPRT bounds
+static void recordGame(Match &match, const GameRecord &record)
+{
+	const MatchOptions &options = match.options;
+	std::lock_guard<std::mutex> lock(match.mutex);
+
+	if (record.result == DRAWN)
+		match.stats.draws++;
+	else if ((record.result == WHITE_WINS) == (record.white == 0))
+		match.stats.wins++;
+	else
+		match.stats.losses++;
+
+	if (match.pgn.is_open())
+		match.pgn << formatPgn(record, options) << std::flush;
+
+	const MatchStats &stats = match.stats;
+	static const char *RESULTS[3] = {"1-0", "0-1", "1/2-1/2"};
+	std::cout << "Finished game " << record.round << " (" << options.names[record.white] << " vs " << options.names[1 - record.white]
+			  << "): " << RESULTS[record.result] << " {" << record.reason << "}\n";
+
+	double margin = 1.96 * std::sqrt(stats.variance() / std::max(stats.games(), 1));
+	double elo = scoreToElo(stats.score());
+	std::printf("Score of %s vs %s: %d - %d - %d  [%.3f] %d\n", options.names[0].c_str(), options.names[1].c_str(),
+				stats.wins, stats.losses, stats.draws, stats.score(), stats.games());
+	std::printf("Elo difference: %.1f +/- %.1f\n", elo, (scoreToElo(stats.score() + margin) - scoreToElo(stats.score() - margin)) / 2);
+
+	if (options.sprt)
+	{
+		double llr = logLikelihoodRatio(stats, options.elo0, options.elo1);
+		double lower = std::log(options.beta / (1 - options.alpha));
+		double upper = std::log((1 - options.beta) / options.alpha);
+		std::printf("SPRT: llr %.2f (%.1f%%), lbound %.2f, ubound %.2f", llr, 100 * llr / upper, lower, upper);
+		if (!match.decided && (llr >= upper || llr <= lower))
+		{
+			match.decided = true;
+			std::printf(" - H%d was accepted", llr >= upper ? 1 : 0);
+		}
+		std::printf("\n");
+	}
+	std::fflush(stdout);
+}
+
+// Function run by each game thread: its own pair of engine processes, one game at a time
+static void runGames(Match &match)
+{
+	EngineProcess engines[2];
+	while (!match.decided.load())
+	{
+		int game = match.nextGame.fetch_add(1);
+		if (match.options.games > 0 && game >= match.options.games)
+			break;
+
+		// Each opening is played twice with colors reversed
+		const Opening &opening = match.openings[(game / 2) % match.openings.size()];
+		GameRecord record = playGame(engines, match.options, opening, game + 1, game % 2);
+		recordGame(match, record);
+	}
+}
+
+static std::string baseName(const std::string &command)
+{
+	std::string first = command.substr(0, command.find(' '));
+	size_t slash = first.find_last_of('/');
+	return slash == std::string::npos ? first : first.substr(slash + 1);
+}
+
+int main(int argc, char *argv[])
+{
+	initBitboards();
+	// A dying engine must not take the match down with it
+	std::signal(SIGPIPE, SIG_IGN);
+
+	Match match;
+	MatchOptions &options = match.options;
+	options.concurrency = int(std::max(1u, std::thread::hardware_concurrency()));
+	bool gamesGiven = false;
+	int engineCount = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-c" && hasValue)
+			options.concurrency = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-g" && hasValue)
+		{
+			options.games = std::atoi(argv[++i]);
+			gamesGiven = true;
+		}
+		else if (arg == "-t" && hasValue)
+			options.moveTime = std::atoll(argv[++i]);
+		else if (arg == "-n" && hasValue)
+			options.nodes = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "-H" && hasValue)
+			options.hashMb = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-o" && hasValue)
+			options.openingsFile = argv[++i];
+		else if (arg == "-p" && hasValue)
+			options.pgnFile = argv[++i];
+		else if (arg == "-s" && i + 2 < argc)
+		{
+			options.sprt = true;
+			options.elo0 = std::atof(argv[++i]);
+			options.elo1 = std::atof(argv[++i]);
+			if (i + 2 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])) && argv[i + 1][1] == '.')
+			{
+				options.alpha = std::atof(argv[++i]);
+				options.beta = std::atof(argv[++i]);
+			}
+		}
+		else if (engineCount < 2 && arg[0] != '-')
+			options.commands[engineCount++] = arg;
+		else
+			engineCount = 3;
+	}
+
+	if (engineCount != 2)
+	{
+		std::cerr << "usage: match [-c concurrency] [-g games] [-t movetimeMs] [-n nodes] [-H hashMB] [-o openings.epd|.pgn]" << std::endl;
+		std::cerr << "             [-p games.pgn] [-s elo0 elo1 [alpha beta]] engine1 engine2" << std::endl;
+		return 1;
+	}
+	if (!options.moveTime && !options.nodes)
+		options.moveTime = 100;
+	// A sequential test runs until it decides unless told otherwise
+	if (options.sprt && !gamesGiven)
+		options.games = 0;
+
+	for (int i = 0; i < 2; i++)
+		options.names[i] = baseName(options.commands[i]);
+	if (options.names[0] == options.names[1])
+	{
+		options.names[0] += "-1";
+		options.names[1] += "-2";
+	}
+
+	if (!options.openingsFile.empty())
+	{
+		match.openings = loadOpenings(options.openingsFile);
+		if (match.openings.empty())
+		{
+			std::cerr << "no openings read from " << options.openingsFile << std::endl;
+			return 1;
+		}
+	}
+	else
+	{
+		Opening start;
+		start.position.setStartPosition();
+		start.fen = START_FEN;
+		match.openings.push_back(start);
+	}
+
+	if (!options.pgnFile.empty())
+	{
+		match.pgn.open(options.pgnFile, std::ios::app);
+		if (!match.pgn)
+		{
+			std::cerr << "cannot write " << options.pgnFile << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << options.names[0] << " vs " << options.names[1] << ", " << match.openings.size() << " openings, "
+			  << options.concurrency << " games at a time" << std::endl;
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < options.concurrency; i++)
+		threads.emplace_back(runGames, std::ref(match));
+	for (std::thread &thread : threads)
+		thread.join();
+	return 0;
+}
@@ -0,0 +1,197 @@
+#include "movepick.h"
+
+#include <algorithm>
+
+#include "evaluate.h"
+
+MovePicker::MovePicker(const Position &position, Move ttMove, const Move killers[2], Move counterMove, const ButterflyHistory &history)
+	: position(position), history(history), stage(STAGE_TT_MOVE)
+{
+	this->ttMove = position.isLegal(ttMove) ? ttMove : MOVE_NONE;
+	refutations[0] = killers[0];
+	refutations[1] = killers[1];
+	refutations[2] = counterMove;
+}
+
+MovePicker::MovePicker(const Position &position, const ButterflyHistory &history)
+	: position(position), history(history), ttMove(MOVE_NONE)
+{
+	stage = position.inCheck() ? STAGE_EVASIONS_INIT : STAGE_QS_INIT_CAPTURES;
+	refutations[0] = refutations[1] = refutations[2] = MOVE_NONE;
+}
+
+// Function to score captures by most valuable victim / least valuable attacker
+void MovePicker::scoreCaptures()
+{
+	for (int i = 0; i < list.size(); i++)
+	{
+		Move move = list.moves[i];
+		PieceKind attacker = pieceKind(position.pieceOn(moveFrom(move)));
+		PieceKind victim = moveFlags(move) == EP_CAPTURE ? PAWN : pieceKind(position.pieceOn(moveTo(move)));
+
+		scores[i] = PIECE_VALUES[victim] * 16 - PIECE_VALUES[attacker] / 16;
+		if (isPromotion(move))
+			scores[i] += PIECE_VALUES[promotionKind(move)] * 16;
+	}
+}
+
+void MovePicker::scoreQuiets()
+{
+	Color us = position.sideToMove();
+	for (int i = 0; i < list.size(); i++)
+		scores[i] = history[us][moveFrom(list.moves[i])][moveTo(list.moves[i])];
+}
+
+// Function to swap the best remaining move into place, so sorting stops as soon as a move cuts off
+Move MovePicker::pickBest()
+{
+	int best = current;
+	for (int i = current + 1; i < list.size(); i++)
+	{
+		if (scores[i] > scores[best])
+			best = i;
+	}
+	std::swap(list.moves[current], list.moves[best]);
+	std::swap(scores[current], scores[best]);
+	return list.moves[current++];
+}
+
+bool MovePicker::isUsefulQuiet(Move move) const
+{
+	return move != MOVE_NONE && move != ttMove && !isCapture(move) && !isPromotion(move) && position.isLegal(move);
+}
+
+bool MovePicker::isRefutation(Move move) const
+{
+	return move == refutations[0] || move == refutations[1] || move == refutations[2];
+}
+
+Move MovePicker::next()
+{
+	switch (stage)
+	{
+	case STAGE_TT_MOVE:
+		stage = STAGE_INIT_CAPTURES;
+		if (ttMove != MOVE_NONE)
+			return ttMove;
+		[[fallthrough]];
+
+	case STAGE_INIT_CAPTURES:
+		list.count = 0;
+		position.generate<GEN_CAPTURES>(list);
+		scoreCaptures();
+		current = 0;
+		stage = STAGE_GOOD_CAPTURES;
+		[[fallthrough]];
+
+	case STAGE_GOOD_CAPTURES:
+		while (current < list.size())
+		{
+			Move move = pickBest();
+			if (move == ttMove)
+				continue;
+			// Underpromotions almost never beat the queen and captures losing the exchange rarely
+			// work out, try them after the quiets
+			if ((isPromotion(move) && promotionKind(move) != QUEEN) || position.losesExchange(move))
+			{
+				deferred[deferredCount++] = move;
+				continue;
+			}
+			return move;
+		}
+		stage = STAGE_KILLER_1;
+		[[fallthrough]];
+
+	case STAGE_KILLER_1:
+		stage = STAGE_KILLER_2;
+		if (isUsefulQuiet(refutations[0]))
+			return refutations[0];
+		refutations[0] = MOVE_NONE;
+		[[fallthrough]];
+
+	case STAGE_KILLER_2:
+		stage = STAGE_COUNTERMOVE;
+		if (refutations[1] != refutations[0] && isUsefulQuiet(refutations[1]))
+			return refutations[1];
+		refutations[1] = MOVE_NONE;
+		[[fallthrough]];
+
+	case STAGE_COUNTERMOVE:
+		stage = STAGE_INIT_QUIETS;
+		if (refutations[2] != refutations[0] && refutations[2] != refutations[1] && isUsefulQuiet(refutations[2]))
+			return refutations[2];
+		refutations[2] = MOVE_NONE;
+		[[fallthrough]];
+
+	case STAGE_INIT_QUIETS:
+		list.count = 0;
+		position.generate<GEN_QUIETS>(list);
+		scoreQuiets();
+		current = 0;
+		stage = STAGE_QUIETS;
+		[[fallthrough]];
+
+	case STAGE_QUIETS:
+		while (current < list.size())
+		{
+			Move move = pickBest();
+			if (move != ttMove && !isRefutation(move))
+				return move;
+		}
+		stage = STAGE_BAD_CAPTURES;
+		[[fallthrough]];
+
+	case STAGE_BAD_CAPTURES:
+		if (deferredCurrent < deferredCount)
+			return deferred[deferredCurrent++];
+		stage = STAGE_DONE;
+		return MOVE_NONE;
+
+	case STAGE_QS_INIT_CAPTURES:
+		list.count = 0;
+		position.generate<GEN_CAPTURES>(list);
+		scoreCaptures();
+		current = 0;
+		stage = STAGE_QS_CAPTURES;
+		[[fallthrough]];
+
+	case STAGE_QS_CAPTURES:
+		while (current < list.size())
+		{
+			Move move = pickBest();
+			if (!isPromotion(move) || promotionKind(move) == QUEEN)
+				return move;
+		}
+		stage = STAGE_DONE;
+		return MOVE_NONE;
+
+	// In check every legal move is an evasion: captures of the checker first, then the rest by history
+	case STAGE_EVASIONS_INIT:
+		list.count = 0;
+		position.generateLegalMoves(list);
+		for (int i = 0; i < list.size(); i++)
+		{
+			Move move = list.moves[i];
+			if (isCapture(move))
+			{
+				PieceKind victim = moveFlags(move) == EP_CAPTURE ? PAWN : pieceKind(position.pieceOn(moveTo(move)));
+				scores[i] = MAX_HISTORY + PIECE_VALUES[victim] * 16 - PIECE_VALUES[pieceKind(position.pieceOn(moveFrom(move)))] / 16;
+			}
+			else
+				scores[i] = history[position.sideToMove()][moveFrom(move)][moveTo(move)];
+		}
+		current = 0;
+		stage = STAGE_EVASIONS;
+		[[fallthrough]];
+
+	case STAGE_EVASIONS:
+		if (current < list.size())
+			return pickBest();
+		stage = STAGE_DONE;
+		return MOVE_NONE;
+
+	case STAGE_DONE:
+		break;
+	}
+	return MOVE_NONE;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "position.h"
+
+const int MAX_HISTORY = 16384;
+
+// How often a quiet move from -> to has caused a cutoff, per side to move
+typedef int ButterflyHistory[2][64][64];
+// The quiet reply that last refuted a move, indexed by the piece that moved and its target square
+typedef Move CounterMoveTable[13][64];
+
+// Hands out the moves of a position one at a time in the order most likely to cause a cutoff.
+// Each group is only generated once the groups before it are used up, so a node that cuts off
+// on the hash move or a capture never generates its quiet moves
+class MovePicker
+{
+public:
+	// Main search: hash move, captures that do not lose the exchange by MVV-LVA, killers,
+	// countermove, quiets by history, then losing captures and underpromotions
+	MovePicker(const Position &position, Move ttMove, const Move killers[2], Move counterMove, const ButterflyHistory &history);
+	// Quiescence search: captures and queen promotions only, or every evasion when in check
+	MovePicker(const Position &position, const ButterflyHistory &history);
+
+	// Next move to search, or MOVE_NONE when there are none left. Every move returned is legal
+	Move next();
+
+private:
+	enum Stage
+	{
+		STAGE_TT_MOVE,
+		STAGE_INIT_CAPTURES,
+		STAGE_GOOD_CAPTURES,
+		STAGE_KILLER_1,
+		STAGE_KILLER_2,
+		STAGE_COUNTERMOVE,
+		STAGE_INIT_QUIETS,
+		STAGE_QUIETS,
+		STAGE_BAD_CAPTURES,
+		STAGE_QS_INIT_CAPTURES,
+		STAGE_QS_CAPTURES,
+		STAGE_EVASIONS_INIT,
+		STAGE_EVASIONS,
+		STAGE_DONE
+	};
+
+	void scoreCaptures();
+	void scoreQuiets();
+	Move pickBest();
+	bool isUsefulQuiet(Move move) const;
+	bool isRefutation(Move move) const;
+
+	const Position &position;
+	const ButterflyHistory &history;
+	Stage stage;
+	Move ttMove;
+	Move refutations[3]; // killers and countermove, MOVE_NONE when not played by their stage
+
+	MoveList list;
+	int scores[MAX_MOVES];
+	int current = 0;
+
+	// Captures put off until after the quiets
+	Move deferred[MAX_MOVES];
+	int deferredCount = 0;
+	int deferredCurrent = 0;
+};
@@ -0,0 +1,268 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define NNUE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NNUE_TARGET(isa)
+#else
+// Lets one binary carry AVX2 and SSE4.1 code without building everything for those CPUs
+#define NNUE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+NnueNetwork NNUE;
+
+enum SimdLevel
+{
+	SIMD_SCALAR,
+	SIMD_SSE41,
+	SIMD_AVX2
+};
+
+// Function to ask the CPU (not the compiler flags) which vector instructions it has
+static int detectSimdLevel()
+{
+#if defined(NNUE_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse41 = (info[2] >> 19) & 1;
+	bool osxsave = (info[2] >> 27) & 1;
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] >> 5) & 1;
+	}
+	return avx2 ? SIMD_AVX2 : sse41 ? SIMD_SSE41 : SIMD_SCALAR;
+#elif defined(NNUE_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return SIMD_SSE41;
+	return SIMD_SCALAR;
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+// Dot product of the clipped accumulator halves with the output weights
+static int32_t forwardScalar(const int16_t *us, const int16_t *them, const int16_t *weights)
+{
+	int32_t sum = 0;
+	for (int i = 0; i < NNUE_HIDDEN; i++)
+		sum += std::clamp<int32_t>(us[i], 0, NNUE_QA) * weights[i];
+	for (int i = 0; i < NNUE_HIDDEN; i++)
+		sum += std::clamp<int32_t>(them[i], 0, NNUE_QA) * weights[NNUE_HIDDEN + i];
+	return sum;
+}
+
+// Accumulator update of one perspective: values += added - removed, either column may be null
+static void updateScalar(int16_t *values, const int16_t *added, const int16_t *removed)
+{
+	for (int i = 0; i < NNUE_HIDDEN; i++)
+		values[i] += (added ? added[i] : 0) - (removed ? removed[i] : 0);
+}
+
+#ifdef NNUE_X86
+NNUE_TARGET("sse4.1")
+static void updateSse41(int16_t *values, const int16_t *added, const int16_t *removed)
+{
+	__m128i *out = reinterpret_cast<__m128i *>(values);
+	const __m128i *plus = reinterpret_cast<const __m128i *>(added);
+	const __m128i *minus = reinterpret_cast<const __m128i *>(removed);
+	for (int i = 0; i < NNUE_HIDDEN / 8; i++)
+	{
+		__m128i v = _mm_load_si128(out + i);
+		if (plus)
+			v = _mm_add_epi16(v, _mm_load_si128(plus + i));
+		if (minus)
+			v = _mm_sub_epi16(v, _mm_load_si128(minus + i));
+		_mm_store_si128(out + i, v);
+	}
+}
+
+NNUE_TARGET("avx2")
+static void updateAvx2(int16_t *values, const int16_t *added, const int16_t *removed)
+{
+	__m256i *out = reinterpret_cast<__m256i *>(values);
+	const __m256i *plus = reinterpret_cast<const __m256i *>(added);
+	const __m256i *minus = reinterpret_cast<const __m256i *>(removed);
+	for (int i = 0; i < NNUE_HIDDEN / 16; i++)
+	{
+		__m256i v = _mm256_load_si256(out + i);
+		if (plus)
+			v = _mm256_add_epi16(v, _mm256_load_si256(plus + i));
+		if (minus)
+			v = _mm256_sub_epi16(v, _mm256_load_si256(minus + i));
+		_mm256_store_si256(out + i, v);
+	}
+}
+
+NNUE_TARGET("sse4.1")
+static int32_t forwardSse41(const int16_t *us, const int16_t *them, const int16_t *weights)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i qa = _mm_set1_epi16(NNUE_QA);
+	__m128i sum = _mm_setzero_si128();
+
+	for (int half = 0; half < 2; half++)
+	{
+		const int16_t *values = half == 0 ? us : them;
+		const int16_t *halfWeights = weights + half * NNUE_HIDDEN;
+		for (int i = 0; i < NNUE_HIDDEN; i += 8)
+		{
+			__m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(values + i));
+			v = _mm_min_epi16(_mm_max_epi16(v, zero), qa);
+			__m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(halfWeights + i));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+		}
+	}
+
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+	return _mm_cvtsi128_si32(sum);
+}
+
+NNUE_TARGET("avx2")
+static int32_t forwardAvx2(const int16_t *us, const int16_t *them, const int16_t *weights)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i qa = _mm256_set1_epi16(NNUE_QA);
+	__m256i sum = _mm256_setzero_si256();
+
+	for (int half = 0; half < 2; half++)
+	{
+		const int16_t *values = half == 0 ? us : them;
+		const int16_t *halfWeights = weights + half * NNUE_HIDDEN;
+		for (int i = 0; i < NNUE_HIDDEN; i += 16)
+		{
+			__m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(values + i));
+			v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+			__m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(halfWeights + i));
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+		}
+	}
+
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+	return _mm_cvtsi128_si32(half);
+}
+#endif
+
+static int featureIndex(Color perspective, PieceType piece, int sq)
+{
+	int relativeSq = perspective == WHITE ? sq : sq ^ 56;
+	return (pieceColor(piece) != perspective ? 384 : 0) + (pieceKind(piece) - 1) * 64 + relativeSq;
+}
+
+bool NnueNetwork::load(const std::string &path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	const size_t count = size_t(NNUE_INPUTS) * NNUE_HIDDEN + NNUE_HIDDEN + 2 * NNUE_HIDDEN + 1;
+	if (size_t(file.tellg()) != count * sizeof(int16_t))
+		return false;
+
+	std::vector<char> bytes(count * sizeof(int16_t));
+	file.seekg(0);
+	if (!file.read(bytes.data(), bytes.size()))
+		return false;
+
+	// Decode byte by byte so the file reads the same on any endianness
+	std::vector<int16_t> values(count);
+	for (size_t i = 0; i < count; i++)
+		values[i] = int16_t(uint8_t(bytes[2 * i]) | uint8_t(bytes[2 * i + 1]) << 8);
+
+	if (!weights)
+		weights = new Weights();
+	const int16_t *next = values.data();
+	std::memcpy(weights->feature, next, sizeof(weights->feature));
+	next += NNUE_INPUTS * NNUE_HIDDEN;
+	std::memcpy(weights->featureBias, next, sizeof(weights->featureBias));
+	next += NNUE_HIDDEN;
+	std::memcpy(weights->output, next, sizeof(weights->output));
+	next += 2 * NNUE_HIDDEN;
+	weights->outputBias = *next;
+
+	simdLevel = detectSimdLevel();
+	isLoaded = true;
+	return true;
+}
+
+const char *NnueNetwork::simdName() const
+{
+	return simdLevel == SIMD_AVX2 ? "AVX2" : simdLevel == SIMD_SSE41 ? "SSE4.1" : "scalar";
+}
+
+void NnueNetwork::reset(Accumulator &accumulator) const
+{
+	for (int perspective = WHITE; perspective <= BLACK; perspective++)
+		std::memcpy(accumulator.values[perspective], weights->featureBias, sizeof(weights->featureBias));
+}
+
+// Function to add the column of one feature and subtract another in both perspectives, with the
+// instruction set picked at load. from or to is SQ_NONE when the piece only appears or disappears
+void NnueNetwork::update(Accumulator &accumulator, PieceType piece, int from, int to) const
+{
+	for (int perspective = WHITE; perspective <= BLACK; perspective++)
+	{
+		const int16_t *removed = from == SQ_NONE ? nullptr : weights->feature[featureIndex(Color(perspective), piece, from)];
+		const int16_t *added = to == SQ_NONE ? nullptr : weights->feature[featureIndex(Color(perspective), piece, to)];
+		int16_t *values = accumulator.values[perspective];
+#ifdef NNUE_X86
+		if (simdLevel == SIMD_AVX2)
+			updateAvx2(values, added, removed);
+		else if (simdLevel == SIMD_SSE41)
+			updateSse41(values, added, removed);
+		else
+#endif
+			updateScalar(values, added, removed);
+	}
+}
+
+void NnueNetwork::addPiece(Accumulator &accumulator, PieceType piece, int sq) const
+{
+	update(accumulator, piece, SQ_NONE, sq);
+}
+
+void NnueNetwork::removePiece(Accumulator &accumulator, PieceType piece, int sq) const
+{
+	update(accumulator, piece, sq, SQ_NONE);
+}
+
+// Function to move a piece in one pass over the accumulator instead of a remove and an add
+void NnueNetwork::movePiece(Accumulator &accumulator, PieceType piece, int from, int to) const
+{
+	update(accumulator, piece, from, to);
+}
+
+int NnueNetwork::evaluate(const Accumulator &accumulator, Color side) const
+{
+	const int16_t *us = accumulator.values[side];
+	const int16_t *them = accumulator.values[~side];
+	int32_t sum;
+
+#ifdef NNUE_X86
+	if (simdLevel == SIMD_AVX2)
+		sum = forwardAvx2(us, them, weights->output);
+	else if (simdLevel == SIMD_SSE41)
+		sum = forwardSse41(us, them, weights->output);
+	else
+#endif
+		sum = forwardScalar(us, them, weights->output);
+
+	return int((int64_t(sum) + int64_t(weights->outputBias) * NNUE_QA) * NNUE_SCALE / (NNUE_QA * NNUE_QB));
+}
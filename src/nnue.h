@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+// Efficiently updatable network: 768 piece-square inputs (6 kinds x 2 colors x 64 squares, seen from
+// each side) feed NNUE_HIDDEN clipped ReLU neurons per side, and both halves, side to move first,
+// feed one output neuron. A move only touches the inputs of the pieces it moves, so the hidden layer
+// (the accumulator) is updated by adding and subtracting weight columns instead of recomputed
+const int NNUE_INPUTS = 768;
+const int NNUE_HIDDEN = 256;
+
+// Quantisation: accumulator values clip to [0, NNUE_QA], output weights are scaled by NNUE_QB and the
+// result by NNUE_SCALE to give centipawns
+const int NNUE_QA = 255;
+const int NNUE_QB = 64;
+const int NNUE_SCALE = 400;
+
+// Hidden layer for both perspectives, indexed by Color
+struct alignas(64) Accumulator
+{
+	int16_t values[2][NNUE_HIDDEN];
+};
+
+// Network file layout, all little endian int16, no header:
+//   feature weights [NNUE_INPUTS][NNUE_HIDDEN], feature biases [NNUE_HIDDEN],
+//   output weights [2 * NNUE_HIDDEN] (side to move half first), output bias (scaled by NNUE_QB)
+// Input index for a piece seen from one side: (theirs ? 384 : 0) + (PieceKind - 1) * 64 + square,
+// with squares flipped vertically when seen from black
+class NnueNetwork
+{
+public:
+	// Reads a network and picks the fastest forward pass this CPU supports. Returns false and
+	// keeps any previous network when the file is missing or has the wrong size
+	bool load(const std::string &path);
+	bool loaded() const { return isLoaded; }
+	// Instruction set the accumulator updates and the forward pass run on: "AVX2", "SSE4.1" or "scalar"
+	const char *simdName() const;
+
+	void reset(Accumulator &accumulator) const;
+	void addPiece(Accumulator &accumulator, PieceType piece, int sq) const;
+	void removePiece(Accumulator &accumulator, PieceType piece, int sq) const;
+	void movePiece(Accumulator &accumulator, PieceType piece, int from, int to) const;
+
+	// Centipawns from the point of view of side
+	int evaluate(const Accumulator &accumulator, Color side) const;
+
+private:
+	void update(Accumulator &accumulator, PieceType piece, int from, int to) const;
+
+	struct alignas(64) Weights
+	{
+		int16_t feature[NNUE_INPUTS][NNUE_HIDDEN];
+		int16_t featureBias[NNUE_HIDDEN];
+		int16_t output[2 * NNUE_HIDDEN];
+		int16_t outputBias;
+	};
+
+	Weights *weights = nullptr;
+	bool isLoaded = false;
+	int simdLevel = 0;
+};
+
+extern NnueNetwork NNUE;
@@ -0,0 +1,120 @@
+#include "pawns.h"
+
+#include <algorithm>
+
+const Score DOUBLED_PENALTY = {-10, -25};
+const Score ISOLATED_PENALTY = {-12, -18};
+const Score SUPPORTED_BONUS = {8, 6};
+// Per file between the two outermost pawns: pawns on both wings are harder to hold in the endgame
+const Score SPAN_BONUS = {0, 4};
+// By rank seen from the pawn's side, on top of the piece-square tables
+const Score PASSED_BONUS[8] = {{0, 0}, {5, 10}, {10, 20}, {15, 35}, {25, 60}, {40, 90}, {60, 130}, {0, 0}};
+
+// Own pawns one and two ranks in front of the king, on its file and the ones next to it
+const int SHIELD_NEAR_BONUS = 15;
+const int SHIELD_FAR_BONUS = 8;
+const int SHIELD_MISSING_PENALTY = -10;
+
+static Bitboard pawnAttacksOf(Color color, Bitboard pawns)
+{
+	return color == WHITE ? ((pawns & ~FILE_A_BB) << 7) | ((pawns & ~FILE_H_BB) << 9)
+						  : ((pawns & ~FILE_A_BB) >> 9) | ((pawns & ~FILE_H_BB) >> 7);
+}
+
+static Bitboard adjacentFiles(int sq)
+{
+	return ((fileBB(sq) & ~FILE_A_BB) >> 1) | ((fileBB(sq) & ~FILE_H_BB) << 1);
+}
+
+// Ranks strictly in front of sq as seen by color
+static Bitboard ranksAhead(Color color, int sq)
+{
+	return color == WHITE ? (rankOf(sq) == 7 ? 0 : ~0ULL << (8 * (rankOf(sq) + 1))) : (1ULL << (8 * rankOf(sq))) - 1;
+}
+
+static Score evaluateSide(Color color, Bitboard ours, Bitboard theirs, Bitboard ourAttacks, Bitboard &passed)
+{
+	Score score = {0, 0};
+	int lowestFile = 8, highestFile = -1;
+	Bitboard pawns = ours;
+	passed = 0;
+	while (pawns)
+	{
+		int sq = popLsb(pawns);
+		Bitboard ahead = ranksAhead(color, sq);
+		lowestFile = std::min(lowestFile, fileOf(sq));
+		highestFile = std::max(highestFile, fileOf(sq));
+
+		// Only the frontmost pawn of a file is not doubled
+		if (ours & fileBB(sq) & ahead)
+			score += DOUBLED_PENALTY;
+		if (!(ours & adjacentFiles(sq)))
+			score += ISOLATED_PENALTY;
+		if (ourAttacks & squareBB(sq))
+			score += SUPPORTED_BONUS;
+		if (!(theirs & (fileBB(sq) | adjacentFiles(sq)) & ahead))
+		{
+			passed |= squareBB(sq);
+			score += PASSED_BONUS[color == WHITE ? rankOf(sq) : 7 - rankOf(sq)];
+		}
+	}
+
+	if (highestFile > lowestFile)
+	{
+		score.mg += SPAN_BONUS.mg * (highestFile - lowestFile);
+		score.eg += SPAN_BONUS.eg * (highestFile - lowestFile);
+	}
+	return score;
+}
+
+void evaluatePawns(const Position &position, PawnEntry &entry)
+{
+	Bitboard white = position.pieces(WHITE, PAWN);
+	Bitboard black = position.pieces(BLACK, PAWN);
+	entry.key = position.pawnKey();
+	entry.attacks[WHITE] = pawnAttacksOf(WHITE, white);
+	entry.attacks[BLACK] = pawnAttacksOf(BLACK, black);
+	entry.score = evaluateSide(WHITE, white, black, entry.attacks[WHITE], entry.passed[WHITE]) - evaluateSide(BLACK, black, white, entry.attacks[BLACK], entry.passed[BLACK]);
+	entry.kingSquare[WHITE] = entry.kingSquare[BLACK] = SQ_NONE;
+}
+
+int kingShelter(const Position &position, PawnEntry &entry, Color color)
+{
+	int king = position.kingSquare(color);
+	if (entry.kingSquare[color] == king)
+		return entry.shelter[color];
+
+	Bitboard pawns = position.pieces(color, PAWN);
+	int forward = color == WHITE ? 8 : -8;
+	int shelter = 0;
+	for (int file = std::max(fileOf(king) - 1, 0); file <= std::min(fileOf(king) + 1, 7); file++)
+	{
+		int near = makeSquare(file, rankOf(king)) + forward;
+		if (near < 0 || near > 63)
+			continue;
+		if (pawns & squareBB(near))
+			shelter += SHIELD_NEAR_BONUS;
+		else if (near + forward >= 0 && near + forward <= 63 && (pawns & squareBB(near + forward)))
+			shelter += SHIELD_FAR_BONUS;
+		else
+			shelter += SHIELD_MISSING_PENALTY;
+	}
+
+	entry.kingSquare[color] = int8_t(king);
+	entry.shelter[color] = int16_t(shelter);
+	return shelter;
+}
+
+PawnEntry &PawnTable::probe(const Position &position)
+{
+	PawnEntry &entry = entries[position.pawnKey() & (PAWN_TABLE_SIZE - 1)];
+	probeCount++;
+	// A fresh entry has key 0, which is also the key of no pawns at all, and then all its terms are right
+	if (entry.key == position.pawnKey())
+	{
+		hitCount++;
+		return entry;
+	}
+	evaluatePawns(position, entry);
+	return entry;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "position.h"
+#include "psqt.h"
+
+// Pawn structure: the terms that only depend on where the pawns stand, cached by pawn key because
+// pawns move far less often than anything else. One entry fills one cache line
+struct alignas(64) PawnEntry
+{
+	uint64_t key = 0;
+	Score score = {0, 0};	  // doubled, isolated, supported and passed pawns and pawn span, white's point of view
+	Bitboard attacks[2] = {}; // squares each color's pawns attack
+	Bitboard passed[2] = {};  // pawns no enemy pawn can stop or capture on their way to promotion
+	// The shield in front of a king depends on the king too, so it is kept for the last king square it was asked for
+	int8_t kingSquare[2] = {SQ_NONE, SQ_NONE};
+	int16_t shelter[2] = {0, 0};
+};
+
+// Fills entry with the pawn terms of position, computed from scratch
+void evaluatePawns(const Position &position, PawnEntry &entry);
+// Middlegame bonus for the pawns shielding color's king, kept in entry for its king square
+int kingShelter(const Position &position, PawnEntry &entry, Color color);
+
+// Direct mapped cache of pawn entries. Each search thread has its own, so nothing is shared or locked
+class PawnTable
+{
+public:
+	PawnTable() : entries(PAWN_TABLE_SIZE) {}
+
+	// Entry for the pawns of position, computed on a miss
+	PawnEntry &probe(const Position &position);
+
+	uint64_t hits() const { return hitCount; }
+	uint64_t probes() const { return probeCount; }
+	void resetCounts() { hitCount = probeCount = 0; }
+
+private:
+	static const size_t PAWN_TABLE_SIZE = 16384; // power of two
+
+	std::vector<PawnEntry> entries;
+	uint64_t hitCount = 0;
+	uint64_t probeCount = 0;
+};
@@ -0,0 +1,180 @@
+// Headless perft: counts the leaves of the legal move tree to validate and time move generation
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "position.h"
+
+// Perft results shared by every thread without locks. The key is stored XORed with the data,
+// so an entry torn by two threads writing at once fails the check instead of returning a wrong count
+struct PerftEntry
+{
+	std::atomic<uint64_t> keyXorData;
+	std::atomic<uint64_t> data; // nodes << 8 | depth
+};
+
+class PerftHash
+{
+public:
+	explicit PerftHash(size_t megabytes)
+	{
+		size_t count = 1;
+		while (count * 2 * sizeof(PerftEntry) <= megabytes * 1024 * 1024)
+			count *= 2;
+		entries.reset(new PerftEntry[count]);
+		for (size_t i = 0; i < count; i++)
+		{
+			entries[i].keyXorData.store(0, std::memory_order_relaxed);
+			entries[i].data.store(0, std::memory_order_relaxed);
+		}
+		mask = count - 1;
+	}
+
+	bool probe(uint64_t key, int depth, uint64_t &nodes) const
+	{
+		const PerftEntry &entry = entries[(key ^ depth) & mask];
+		uint64_t data = entry.data.load(std::memory_order_relaxed);
+		if ((entry.keyXorData.load(std::memory_order_relaxed) ^ data) != key || int(data & 0xFF) != depth)
+			return false;
+		nodes = data >> 8;
+		return true;
+	}
+
+	void store(uint64_t key, int depth, uint64_t nodes)
+	{
+		PerftEntry &entry = entries[(key ^ depth) & mask];
+		uint64_t data = (nodes << 8) | uint64_t(depth);
+		entry.keyXorData.store(key ^ data, std::memory_order_relaxed);
+		entry.data.store(data, std::memory_order_relaxed);
+	}
+
+private:
+	std::unique_ptr<PerftEntry[]> entries;
+	size_t mask;
+};
+
+static uint64_t perft(Position &position, int depth, PerftHash *hash)
+{
+	MoveList list;
+	position.generateLegalMoves(list);
+
+	// Bulk counting: the leaves are the legal moves one ply above them
+	if (depth == 1)
+		return list.size();
+
+	uint64_t key = 0, nodes = 0;
+	if (hash)
+	{
+		key = position.key();
+		if (hash->probe(key, depth, nodes))
+			return nodes;
+	}
+
+	for (Move move : list)
+	{
+		UndoInfo undo;
+		position.makeMove(move, undo);
+		nodes += perft(position, depth - 1, hash);
+		position.unmakeMove(move, undo);
+	}
+
+	if (hash)
+		hash->store(key, depth, nodes);
+	return nodes;
+}
+
+// Function to split the root moves over a pool of threads, each one working on its own copy of the position
+static uint64_t divide(const Position &root, int depth, int threads, PerftHash *hash)
+{
+	MoveList rootMoves;
+	root.generateLegalMoves(rootMoves);
+	std::vector<uint64_t> counts(rootMoves.size(), 0);
+	std::atomic<int> next(0);
+
+	auto worker = [&]()
+	{
+		Position position = root;
+		for (int i = next++; i < rootMoves.size(); i = next++)
+		{
+			UndoInfo undo;
+			position.makeMove(rootMoves.moves[i], undo);
+			counts[i] = depth > 1 ? perft(position, depth - 1, hash) : 1;
+			position.unmakeMove(rootMoves.moves[i], undo);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (int i = 0; i < threads; i++)
+		pool.emplace_back(worker);
+	for (std::thread &thread : pool)
+		thread.join();
+
+	uint64_t total = 0;
+	for (int i = 0; i < rootMoves.size(); i++)
+	{
+		std::cout << moveToUci(rootMoves.moves[i]) << ": " << counts[i] << std::endl;
+		total += counts[i];
+	}
+	return total;
+}
+
+static void printUsage()
+{
+	std::cout << "Usage: perft [-t threads] [-H hashMB] depth [fen]" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t hashMegabytes = 0;
+	int depth = -1;
+	std::string fen;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-t" && i + 1 < argc)
+			threads = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-H" && i + 1 < argc)
+			hashMegabytes = std::strtoul(argv[++i], nullptr, 10);
+		else if (depth < 0)
+			depth = std::atoi(arg.c_str());
+		else
+			fen += (fen.empty() ? "" : " ") + arg;
+	}
+
+	if (depth < 1)
+	{
+		printUsage();
+		return 1;
+	}
+
+	initBitboards();
+
+	Position position;
+	if (!position.setFromFen(fen.empty() ? START_FEN : fen))
+	{
+		std::cerr << "Invalid FEN: " << fen << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<PerftHash> hash;
+	if (hashMegabytes > 0)
+		hash.reset(new PerftHash(hashMegabytes));
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t nodes = divide(position, depth, threads, hash.get());
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::endl;
+	std::cout << "Nodes: " << nodes << std::endl;
+	std::cout << "Time: " << int(seconds * 1000) << " ms (" << threads << " threads" << (hash ? ", hash " + std::to_string(hashMegabytes) + " MB" : "") << ")" << std::endl;
+	std::cout << "NPS: " << uint64_t(nodes / std::max(seconds, 1e-9)) << std::endl;
+	return 0;
+}
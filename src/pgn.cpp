@@ -0,0 +1,84 @@
+#include "pgn.h"
+
+#include <sstream>
+
+static bool isResult(const std::string &token)
+{
+	return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+bool readPgnGame(std::istream &in, PgnGame &game)
+{
+	game.start.setStartPosition();
+	game.moves.clear();
+	game.result.clear();
+
+	Position current = game.start;
+	bool started = false, broken = false;
+	int commentDepth = 0, variationDepth = 0;
+	std::string line;
+
+	while (std::getline(in, line))
+	{
+		if (commentDepth == 0 && variationDepth == 0 && !line.empty() && line[0] == '[')
+		{
+			// A tag after movetext means the result token is missing. The game ends here and the
+			// next one loses this tag, which is harmless unless it is its FEN
+			if (!game.moves.empty())
+				return true;
+			size_t quote = line.find('"');
+			if (line.compare(0, 5, "[FEN ") == 0 && quote != std::string::npos && game.start.setFromFen(line.substr(quote + 1, line.rfind('"') - quote - 1)))
+				current = game.start;
+			started = true;
+			continue;
+		}
+
+		std::istringstream stream(line);
+		std::string token;
+		while (stream >> token)
+		{
+			if (commentDepth == 0 && variationDepth == 0 && isResult(token))
+			{
+				game.result = token;
+				return true;
+			}
+
+			bool skip = broken || commentDepth > 0 || variationDepth > 0 || token[0] == '$' || token[0] == ';';
+			for (char c : token)
+			{
+				if (c == '{')
+					commentDepth++;
+				else if (c == '}' && commentDepth > 0)
+					commentDepth--;
+				else if (c == '(' && commentDepth == 0)
+					variationDepth++;
+				else if (c == ')' && commentDepth == 0 && variationDepth > 0)
+					variationDepth--;
+			}
+			// The rest of the line is a comment
+			if (token[0] == ';' && commentDepth == 0)
+				break;
+			if (skip || token.find_first_of("{}()") != std::string::npos)
+				continue;
+
+			// Move numbers, alone ("12." "12...") or stuck to the move ("12.Nf3")
+			size_t dot = token.find_last_of('.');
+			if (dot != std::string::npos)
+				token = token.substr(dot + 1);
+			if (token.empty())
+				continue;
+
+			started = true;
+			Move move = moveFromSan(current, token);
+			if (move == MOVE_NONE)
+			{
+				broken = true;
+				continue;
+			}
+			UndoInfo undo;
+			current.makeMove(move, undo);
+			game.moves.push_back(move);
+		}
+	}
+	return started;
+}
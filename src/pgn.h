@@ -0,0 +1,21 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "position.h"
+
+// One game read from a PGN file: the position it starts from (the FEN tag, else the start
+// position), the moves played and the result token
+struct PgnGame
+{
+	Position start;
+	std::vector<Move> moves;
+	std::string result;
+};
+
+// Reads the next game, false once the input holds no more. Comments, variations, move numbers and
+// annotation glyphs are skipped. Moves after one that is not legal are dropped, so a damaged game
+// still yields its opening
+bool readPgnGame(std::istream &in, PgnGame &game);
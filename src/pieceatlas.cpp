@@ -0,0 +1,366 @@
+#include "pieceatlas.h"
+
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// One sprite to load on a worker thread, with what it took
+struct SpriteJob
+{
+	std::string file;
+	SDL_Surface *surface = nullptr;
+	bool fromCache = false;
+	double readMs = 0;
+	double rasterizeMs = 0;
+	double cacheMs = 0;
+};
+
+// Tag of the cache files, changed whenever their layout does
+static const char CACHE_MAGIC[4] = {'P', 'C', 'S', '1'};
+
+// Function to hash the contents of a file, 64 bit FNV-1a
+static uint64_t hashBytes(const std::vector<char> &bytes)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (char byte : bytes)
+	{
+		hash ^= static_cast<unsigned char>(byte);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static bool readFile(const std::string &file, std::vector<char> &bytes)
+{
+	std::ifstream stream(file, std::ios::binary);
+	if (!stream)
+		return false;
+	bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// Function to read a sprite the cache holds: the tag, width and height, then the RGBA rows
+static SDL_Surface *loadCachedSprite(const std::string &path, int size)
+{
+	std::ifstream stream(path, std::ios::binary);
+	char magic[4];
+	int32_t width, height;
+	if (!stream.read(magic, 4) || !std::equal(magic, magic + 4, CACHE_MAGIC) || !stream.read(reinterpret_cast<char *>(&width), sizeof(width)) ||
+		!stream.read(reinterpret_cast<char *>(&height), sizeof(height)) || width != size || height != size)
+		return nullptr;
+
+	SDL_Surface *sprite = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_RGBA32);
+	for (int y = 0; sprite && y < size; y++)
+	{
+		if (!stream.read(static_cast<char *>(sprite->pixels) + y * sprite->pitch, size * 4))
+		{
+			SDL_FreeSurface(sprite);
+			return nullptr;
+		}
+	}
+	return sprite;
+}
+
+// Function to add a sprite to the cache. It is written under another name first and renamed, so
+// a game starting at the same time never reads half a file
+static void saveCachedSprite(const std::string &path, SDL_Surface *sprite)
+{
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+		int32_t width = sprite->w, height = sprite->h;
+		stream.write(CACHE_MAGIC, 4);
+		stream.write(reinterpret_cast<const char *>(&width), sizeof(width));
+		stream.write(reinterpret_cast<const char *>(&height), sizeof(height));
+		for (int y = 0; y < sprite->h; y++)
+			stream.write(static_cast<const char *>(sprite->pixels) + y * sprite->pitch, sprite->w * 4);
+		if (!stream)
+		{
+			stream.close();
+			std::remove(temporary.c_str());
+			return;
+		}
+	}
+	if (std::rename(temporary.c_str(), path.c_str()) != 0)
+		std::remove(temporary.c_str());
+}
+
+// Function to rasterize a sprite file into a size x size RGBA surface. SVG files are rendered
+// straight at that size where SDL_image can, instead of scaling their default size
+static SDL_Surface *rasterizeSprite(const std::vector<char> &bytes, int size)
+{
+	SDL_Surface *loaded = nullptr;
+#if SDL_IMAGE_VERSION_ATLEAST(2, 6, 0)
+	SDL_RWops *source = SDL_RWFromConstMem(bytes.data(), int(bytes.size()));
+	if (source && IMG_isSVG(source))
+		loaded = IMG_LoadSizedSVG_RW(source, size, size);
+	if (source)
+		SDL_RWclose(source);
+#endif
+	if (!loaded)
+		loaded = IMG_Load_RW(SDL_RWFromConstMem(bytes.data(), int(bytes.size())), 1);
+	if (!loaded)
+		return nullptr;
+
+	SDL_Surface *converted = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(loaded);
+	if (!converted || (converted->w == size && converted->h == size))
+		return converted;
+
+	SDL_Surface *sprite = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_RGBA32);
+	if (sprite)
+	{
+		SDL_SetSurfaceBlendMode(converted, SDL_BLENDMODE_NONE);
+		SDL_BlitScaled(converted, nullptr, sprite, nullptr);
+	}
+	SDL_FreeSurface(converted);
+	return sprite;
+}
+
+// Function run on a worker thread: the sprite from the cache, or rasterized and added to it. Only
+// touches surfaces, which unlike textures can be made off the renderer's thread
+static void loadSprite(SpriteJob &job, int size, const std::string &cacheDirectory)
+{
+	Clock::time_point start = Clock::now();
+	std::vector<char> bytes;
+	if (!readFile(job.file, bytes))
+	{
+		std::cerr << "Failed to read " << job.file << std::endl;
+		return;
+	}
+	std::string cachePath;
+	if (!cacheDirectory.empty())
+	{
+		std::ostringstream name;
+		name << cacheDirectory << "piece-" << std::hex << std::setw(16) << std::setfill('0') << hashBytes(bytes) << std::dec << "-" << size << ".rgba";
+		cachePath = name.str();
+	}
+	job.readMs = millisecondsSince(start);
+
+	if (!cachePath.empty())
+	{
+		start = Clock::now();
+		job.surface = loadCachedSprite(cachePath, size);
+		job.fromCache = job.surface != nullptr;
+		job.cacheMs = millisecondsSince(start);
+		if (job.fromCache)
+		{
+			// Marks the size as used now, which pruneCache goes by
+			std::error_code error;
+			std::filesystem::last_write_time(cachePath, std::filesystem::file_time_type::clock::now(), error);
+			return;
+		}
+	}
+
+	start = Clock::now();
+	job.surface = rasterizeSprite(bytes, size);
+	job.rasterizeMs = millisecondsSince(start);
+	if (!job.surface)
+	{
+		std::cerr << "Failed to load " << job.file << ": " << IMG_GetError() << std::endl;
+		return;
+	}
+
+	if (!cachePath.empty())
+	{
+		start = Clock::now();
+		saveCachedSprite(cachePath, job.surface);
+		job.cacheMs += millisecondsSince(start);
+	}
+}
+
+bool PieceAtlas::build(SDL_Renderer *renderer, const std::string files[PIECE_COUNT], int pixelSize)
+{
+	release();
+	Clock::time_point start = Clock::now();
+	times = BuildTimes();
+	size = pixelSize;
+
+	// Sprites are handed out one at a time, the calling thread working as one of the workers
+	SpriteJob jobs[PIECE_COUNT];
+	for (int i = 0; i < PIECE_COUNT; i++)
+		jobs[i].file = files[i];
+	std::atomic<int> next(0);
+	auto worker = [&]()
+	{
+		for (int i = next++; i < PIECE_COUNT; i = next++)
+			loadSprite(jobs[i], size, cacheDirectory);
+	};
+	times.threads = std::max(1, std::min(PIECE_COUNT, int(std::thread::hardware_concurrency())));
+	std::vector<std::thread> pool;
+	for (int i = 1; i < times.threads; i++)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread &thread : pool)
+		thread.join();
+
+	for (const SpriteJob &job : jobs)
+	{
+		times.readMs += job.readMs;
+		times.rasterizeMs += job.rasterizeMs;
+		times.cacheMs += job.cacheMs;
+		times.cacheHits += job.fromCache ? 1 : 0;
+	}
+	if (!cacheDirectory.empty() && times.cacheHits < PIECE_COUNT)
+	{
+		Clock::time_point pruneStart = Clock::now();
+		pruneCache();
+		times.cacheMs += millisecondsSince(pruneStart);
+	}
+
+	// A grid of cells one pixel apart so filtering never bleeds a neighbour in, the white cell last
+	Clock::time_point uploadStart = Clock::now();
+	const int rows = (PIECE_COUNT + 1 + COLUMNS - 1) / COLUMNS;
+	atlasWidth = COLUMNS * (size + 1);
+	atlasHeight = rows * (size + 1);
+	SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, atlasWidth, atlasHeight, 32, SDL_PIXELFORMAT_RGBA32);
+	for (int i = 0; i < PIECE_COUNT; i++)
+	{
+		sources[i] = {0, 0, 0, 0};
+		if (!jobs[i].surface)
+			continue;
+		if (atlas)
+		{
+			SDL_Rect cell = {(i % COLUMNS) * (size + 1), (i / COLUMNS) * (size + 1), size, size};
+			SDL_SetSurfaceBlendMode(jobs[i].surface, SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(jobs[i].surface, nullptr, atlas, &cell);
+			sources[i] = cell;
+		}
+		SDL_FreeSurface(jobs[i].surface);
+	}
+	if (!atlas)
+	{
+		std::cerr << "Failed to create the piece atlas: " << SDL_GetError() << std::endl;
+		return false;
+	}
+
+	// Solid fills sample the middle texel of a 3 x 3 white block, so filtering only ever sees white
+	SDL_Rect block = {(PIECE_COUNT % COLUMNS) * (size + 1), (PIECE_COUNT / COLUMNS) * (size + 1), 3, 3};
+	SDL_FillRect(atlas, &block, SDL_MapRGBA(atlas->format, 255, 255, 255, 255));
+	white = {block.x + 1, block.y + 1, 1, 1};
+
+	texture = SDL_CreateTextureFromSurface(renderer, atlas);
+	SDL_FreeSurface(atlas);
+	if (!texture)
+	{
+		std::cerr << "Failed to create the piece atlas texture: " << SDL_GetError() << std::endl;
+		return false;
+	}
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	textureCount++;
+	times.uploadMs = millisecondsSince(uploadStart);
+	times.totalMs = millisecondsSince(start);
+	return true;
+}
+
+// Function to delete the cached sprites of all but the MAX_CACHED_SIZES sizes written or read last,
+// so resizing the window through many sizes does not fill the directory
+void PieceAtlas::pruneCache() const
+{
+	// Last use of each size, from the files named piece-<hash>-<size>.rgba
+	std::map<int, std::filesystem::file_time_type> lastUse;
+	std::vector<std::pair<std::filesystem::path, int>> files;
+	std::error_code error;
+	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(cacheDirectory, error))
+	{
+		std::string name = entry.path().filename().string();
+		size_t dash = name.rfind('-');
+		if (name.compare(0, 6, "piece-") != 0 || entry.path().extension() != ".rgba" || dash == std::string::npos || dash < 6)
+			continue;
+		int fileSize = std::atoi(name.c_str() + dash + 1);
+		std::filesystem::file_time_type time = entry.last_write_time(error);
+		if (fileSize <= 0 || error)
+			continue;
+		files.emplace_back(entry.path(), fileSize);
+		if (!lastUse.count(fileSize) || lastUse[fileSize] < time)
+			lastUse[fileSize] = time;
+	}
+	if (int(lastUse.size()) <= MAX_CACHED_SIZES)
+		return;
+
+	// The size just built stays, then the others from the most recently used
+	std::vector<std::pair<std::filesystem::file_time_type, int>> byLastUse;
+	for (const auto &use : lastUse)
+		byLastUse.emplace_back(use.second, use.first);
+	std::sort(byLastUse.begin(), byLastUse.end(), std::greater<>());
+	std::set<int> kept = {size};
+	for (size_t i = 0; i < byLastUse.size() && int(kept.size()) < MAX_CACHED_SIZES; i++)
+		kept.insert(byLastUse[i].second);
+	for (const auto &file : files)
+	{
+		if (!kept.count(file.second))
+			std::filesystem::remove(file.first, error);
+	}
+}
+
+void PieceAtlas::release()
+{
+	if (texture)
+		SDL_DestroyTexture(texture);
+	texture = nullptr;
+	vertices.clear();
+	indices.clear();
+}
+
+void PieceAtlas::addQuad(const SDL_Rect &rect, SDL_Color color, float s0, float t0, float s1, float t1)
+{
+	float left = float(rect.x), top = float(rect.y);
+	float right = left + rect.w, bottom = top + rect.h;
+
+	int first = int(vertices.size());
+	vertices.push_back({{left, top}, color, {s0, t0}});
+	vertices.push_back({{right, top}, color, {s1, t0}});
+	vertices.push_back({{left, bottom}, color, {s0, t1}});
+	vertices.push_back({{right, bottom}, color, {s1, t1}});
+	for (int corner : {0, 1, 2, 2, 1, 3})
+		indices.push_back(first + corner);
+	quadCount++;
+}
+
+void PieceAtlas::addPiece(int piece, const SDL_Rect &rect)
+{
+	if (!texture || piece < 1 || piece > PIECE_COUNT || sources[piece - 1].w == 0)
+		return;
+	const SDL_Rect &source = sources[piece - 1];
+	const float u = 1.0f / atlasWidth;
+	const float v = 1.0f / atlasHeight;
+	addQuad(rect, {255, 255, 255, 255}, source.x * u, source.y * v, (source.x + source.w) * u, (source.y + source.h) * v);
+}
+
+void PieceAtlas::addRect(const SDL_Rect &rect, SDL_Color color)
+{
+	if (!texture)
+		return;
+	float s = (white.x + 0.5f) / atlasWidth;
+	float t = (white.y + 0.5f) / atlasHeight;
+	addQuad(rect, color, s, t, s, t);
+}
+
+void PieceAtlas::flush(SDL_Renderer *renderer)
+{
+	if (indices.empty())
+		return;
+	SDL_RenderGeometry(renderer, texture, vertices.data(), int(vertices.size()), indices.data(), int(indices.size()));
+	drawCallCount++;
+	vertices.clear();
+	indices.clear();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The twelve piece sprites rasterized once, at the size they are drawn, into a single texture that
+// also has a white cell for solid fills. Pieces and coloured squares are queued as quads that
+// flush() draws with one SDL_RenderGeometry call, so a whole board of pieces and highlights is one
+// draw call and one texture bind.
+//
+// The sprites are rasterized on worker threads, then composed and uploaded on the calling thread
+// (the renderer's). Rasterized sprites are kept on disk, keyed by the hash of the file and the
+// size, so later builds at a size seen before read pixels instead of parsing SVG. Only the
+// MAX_CACHED_SIZES sizes used last are kept
+class PieceAtlas
+{
+public:
+	static constexpr int PIECE_COUNT = 12;
+	static constexpr int MAX_CACHED_SIZES = 4;
+
+	// Time the last build took. Reading, rasterizing and the cache are summed over the worker
+	// threads, so together they can exceed the total
+	struct BuildTimes
+	{
+		double totalMs = 0;
+		double readMs = 0;
+		double rasterizeMs = 0;
+		double cacheMs = 0;
+		double uploadMs = 0; // composing the atlas and creating its texture
+		int cacheHits = 0;
+		int threads = 0;
+	};
+
+	PieceAtlas() = default;
+	PieceAtlas(const PieceAtlas &) = delete;
+	PieceAtlas &operator=(const PieceAtlas &) = delete;
+	~PieceAtlas() { release(); }
+
+	// Directory the rasterized sprites are kept in, ending with a separator. Empty keeps none
+	void setCacheDirectory(const std::string &directory) { cacheDirectory = directory; }
+
+	// Rasterizes files[piece - 1] at pixelSize x pixelSize. A piece whose file cannot be read is not drawn
+	bool build(SDL_Renderer *renderer, const std::string files[PIECE_COUNT], int pixelSize);
+	void release();
+
+	// Pixel size of the sprites, 0 before build
+	int spriteSize() const { return size; }
+	const BuildTimes &buildTimes() const { return times; }
+
+	// Queues piece (1 to 12, as Position::pieceOn) stretched over rect
+	void addPiece(int piece, const SDL_Rect &rect);
+	// Queues rect filled with color, blended by its alpha
+	void addRect(const SDL_Rect &rect, SDL_Color color);
+	// Draws the quads queued since the last flush, in the order they were queued
+	void flush(SDL_Renderer *renderer);
+
+	// Textures created over the atlas' life (one per build), and draw calls and quads drawn
+	int texturesCreated() const { return textureCount; }
+	uint64_t drawCalls() const { return drawCallCount; }
+	uint64_t quadsDrawn() const { return quadCount; }
+
+private:
+	static const int COLUMNS = 4;
+
+	void addQuad(const SDL_Rect &rect, SDL_Color color, float s0, float t0, float s1, float t1);
+	void pruneCache() const;
+
+	std::string cacheDirectory;
+	BuildTimes times;
+
+	SDL_Texture *texture = nullptr;
+	int size = 0;
+	int atlasWidth = 0;
+	int atlasHeight = 0;
+	SDL_Rect sources[PIECE_COUNT] = {};
+	SDL_Rect white = {};
+
+	// Reused between flushes so steady state drawing does not allocate
+	std::vector<SDL_Vertex> vertices;
+	std::vector<int> indices;
+
+	int textureCount = 0;
+	uint64_t drawCallCount = 0;
+	uint64_t quadCount = 0;
+};
@@ -0,0 +1,982 @@
+#include "position.h"
+#include "tt.h"
+#include "zobrist.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+static const char PIECE_CHARS[] = " prnbqkPRNBQK";
+
+// Exchange values by PieceKind. The king is worth more than everything else together, so taking a
+// defended piece with it always scores as a loss
+static const int SEE_VALUES[7] = {0, 100, 500, 320, 330, 900, 20000};
+static const PieceKind CHEAPEST_FIRST[6] = {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING};
+
+// Castling rights that survive a move touching each square
+static int CastlingMask[64];
+
+static struct CastlingMaskInit
+{
+	CastlingMaskInit()
+	{
+		for (int sq = 0; sq < 64; sq++)
+			CastlingMask[sq] = ALL_CASTLING;
+		CastlingMask[SQ_E1] &= ~(WHITE_OO | WHITE_OOO);
+		CastlingMask[SQ_H1] &= ~WHITE_OO;
+		CastlingMask[SQ_A1] &= ~WHITE_OOO;
+		CastlingMask[SQ_E8] &= ~(BLACK_OO | BLACK_OOO);
+		CastlingMask[SQ_H8] &= ~BLACK_OO;
+		CastlingMask[SQ_A8] &= ~BLACK_OOO;
+	}
+} castlingMaskInit;
+
+Position::Position()
+{
+	clear();
+}
+
+void Position::clear()
+{
+	for (int sq = 0; sq < 64; sq++)
+		board[sq] = EMPTY;
+	for (int piece = 0; piece < 13; piece++)
+		pieceBB[piece] = 0;
+	colorBB[WHITE] = colorBB[BLACK] = 0;
+	occupiedBB = 0;
+	side = WHITE;
+	castlingRights = 0;
+	epSquare = SQ_NONE;
+	halfmoveClock = 0;
+	fullmoveNumber = 1;
+	hashKey = 0;
+	pawnHashKey = 0;
+	psq = {0, 0};
+	phase = 0;
+	if (NNUE.loaded())
+		NNUE.reset(accumulator);
+}
+
+void Position::setStartPosition()
+{
+	static const PieceKind backRank[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+
+	clear();
+	for (int file = 0; file < 8; file++)
+	{
+		putPiece(makePiece(WHITE, backRank[file]), makeSquare(file, 0));
+		putPiece(makePiece(WHITE, PAWN), makeSquare(file, 1));
+		putPiece(makePiece(BLACK, PAWN), makeSquare(file, 6));
+		putPiece(makePiece(BLACK, backRank[file]), makeSquare(file, 7));
+	}
+	castlingRights = ALL_CASTLING;
+	hashKey ^= ZOBRIST.castling[castlingRights];
+}
+
+bool Position::setFromFen(const std::string &fen)
+{
+	std::istringstream stream(fen);
+	std::string placement, color, castlingField, epField;
+	Position parsed;
+
+	if (!(stream >> placement >> color))
+		return false;
+
+	// Piece placement starts on a8 and walks each rank from the a file
+	int file = 0, rank = 7;
+	for (char c : placement)
+	{
+		if (c == '/')
+		{
+			if (file != 8 || rank == 0)
+				return false;
+			file = 0;
+			rank--;
+		}
+		else if (c >= '1' && c <= '8')
+			file += c - '0';
+		else
+		{
+			const char *found = c != ' ' ? std::strchr(PIECE_CHARS, c) : nullptr;
+			if (!found || file > 7)
+				return false;
+			parsed.putPiece(PieceType(found - PIECE_CHARS), makeSquare(file, rank));
+			file++;
+		}
+		if (file > 8)
+			return false;
+	}
+	if (rank != 0 || file != 8)
+		return false;
+
+	if (color != "w" && color != "b")
+		return false;
+	parsed.side = color == "w" ? WHITE : BLACK;
+
+	// Castling, en passant and the clocks are optional so EPD lines parse too
+	if (stream >> castlingField && castlingField != "-")
+	{
+		for (char c : castlingField)
+		{
+			if (c == 'K')
+				parsed.castlingRights |= WHITE_OO;
+			else if (c == 'Q')
+				parsed.castlingRights |= WHITE_OOO;
+			else if (c == 'k')
+				parsed.castlingRights |= BLACK_OO;
+			else if (c == 'q')
+				parsed.castlingRights |= BLACK_OOO;
+			else
+				return false;
+		}
+
+		// Drop rights whose king or rook is not on its original square
+		if (parsed.board[SQ_E1] != WHITE_KING)
+			parsed.castlingRights &= ~(WHITE_OO | WHITE_OOO);
+		if (parsed.board[SQ_H1] != WHITE_ROOK)
+			parsed.castlingRights &= ~WHITE_OO;
+		if (parsed.board[SQ_A1] != WHITE_ROOK)
+			parsed.castlingRights &= ~WHITE_OOO;
+		if (parsed.board[SQ_E8] != BLACK_KING)
+			parsed.castlingRights &= ~(BLACK_OO | BLACK_OOO);
+		if (parsed.board[SQ_H8] != BLACK_ROOK)
+			parsed.castlingRights &= ~BLACK_OO;
+		if (parsed.board[SQ_A8] != BLACK_ROOK)
+			parsed.castlingRights &= ~BLACK_OOO;
+	}
+
+	if (stream >> epField && epField != "-")
+	{
+		if (epField.size() != 2 || epField[0] < 'a' || epField[0] > 'h' || (epField[1] != '3' && epField[1] != '6'))
+			return false;
+		int sq = makeSquare(epField[0] - 'a', epField[1] - '1');
+		// Keep the square only when the pawn that just moved two squares stands in front of it, the
+		// square and the one it came from are empty and a pawn can capture, like makeMove does
+		int up = parsed.side == WHITE ? 8 : -8;
+		bool isRankRight = epField[1] == (parsed.side == WHITE ? '6' : '3');
+		if (isRankRight && parsed.board[sq - up] == makePiece(~parsed.side, PAWN) && parsed.board[sq] == EMPTY && parsed.board[sq + up] == EMPTY &&
+			(pawnAttacks(~parsed.side, sq) & parsed.pieces(parsed.side, PAWN)))
+			parsed.epSquare = sq;
+	}
+
+	int halfmove = 0, fullmove = 1;
+	if (stream >> halfmove)
+	{
+		parsed.halfmoveClock = halfmove;
+		if (stream >> fullmove)
+			parsed.fullmoveNumber = fullmove < 1 ? 1 : fullmove;
+	}
+
+	if (!parsed.isValid())
+		return false;
+
+	parsed.hashKey ^= ZOBRIST.castling[parsed.castlingRights];
+	if (parsed.epSquare != SQ_NONE)
+		parsed.hashKey ^= ZOBRIST.enPassant[fileOf(parsed.epSquare)];
+	if (parsed.side == BLACK)
+		parsed.hashKey ^= ZOBRIST.side;
+
+	*this = parsed;
+	return true;
+}
+
+bool Position::setFromPieces(const PieceType pieces[], const int squares[], int count, Color toMove)
+{
+	clear();
+	for (int i = 0; i < count; i++)
+	{
+		if (board[squares[i]] != EMPTY)
+			return false;
+		putPiece(pieces[i], squares[i]);
+	}
+
+	side = toMove;
+	hashKey ^= ZOBRIST.castling[0];
+	if (side == BLACK)
+		hashKey ^= ZOBRIST.side;
+	return isValid();
+}
+
+std::string Position::fen() const
+{
+	std::string text;
+	for (int rank = 7; rank >= 0; rank--)
+	{
+		int empty = 0;
+		for (int file = 0; file < 8; file++)
+		{
+			PieceType piece = board[makeSquare(file, rank)];
+			if (piece == EMPTY)
+			{
+				empty++;
+				continue;
+			}
+			if (empty)
+				text += char('0' + empty);
+			empty = 0;
+			text += PIECE_CHARS[piece];
+		}
+		if (empty)
+			text += char('0' + empty);
+		if (rank > 0)
+			text += '/';
+	}
+
+	text += side == WHITE ? " w " : " b ";
+	if (castlingRights & WHITE_OO)
+		text += 'K';
+	if (castlingRights & WHITE_OOO)
+		text += 'Q';
+	if (castlingRights & BLACK_OO)
+		text += 'k';
+	if (castlingRights & BLACK_OOO)
+		text += 'q';
+	if (!castlingRights)
+		text += '-';
+
+	text += ' ' + (epSquare != SQ_NONE ? squareName(epSquare) : std::string("-"));
+	text += ' ' + std::to_string(halfmoveClock) + ' ' + std::to_string(fullmoveNumber);
+	return text;
+}
+
+bool Position::isInsufficientMaterial() const
+{
+	if (pieceBB[WHITE_PAWN] | pieceBB[BLACK_PAWN] | pieceBB[WHITE_ROOK] | pieceBB[BLACK_ROOK] | pieceBB[WHITE_QUEEN] | pieceBB[BLACK_QUEEN])
+		return false;
+	return popcount(occupiedBB) <= 3;
+}
+
+// Function to reject positions the move generator cannot handle
+bool Position::isValid() const
+{
+	if (popcount(pieces(WHITE, KING)) != 1 || popcount(pieces(BLACK, KING)) != 1)
+		return false;
+	if ((pieces(WHITE, PAWN) | pieces(BLACK, PAWN)) & (RANK_1_BB | RANK_8_BB))
+		return false;
+	// The side that just moved cannot have left its king in check
+	return !isAttacked(kingSquare(~side), side);
+}
+
+void Position::putPiece(PieceType piece, int sq)
+{
+	Bitboard b = squareBB(sq);
+	board[sq] = piece;
+	pieceBB[piece] |= b;
+	colorBB[pieceColor(piece)] |= b;
+	occupiedBB |= b;
+	hashKey ^= ZOBRIST.psq[piece][sq];
+	if (pieceKind(piece) == PAWN)
+		pawnHashKey ^= ZOBRIST.psq[piece][sq];
+	psq += PSQT.values[piece][sq];
+	phase += PHASE_WEIGHTS[pieceKind(piece)];
+	if (NNUE.loaded())
+		NNUE.addPiece(accumulator, piece, sq);
+}
+
+void Position::removePiece(int sq)
+{
+	PieceType piece = board[sq];
+	Bitboard b = squareBB(sq);
+	board[sq] = EMPTY;
+	pieceBB[piece] ^= b;
+	colorBB[pieceColor(piece)] ^= b;
+	occupiedBB ^= b;
+	hashKey ^= ZOBRIST.psq[piece][sq];
+	if (pieceKind(piece) == PAWN)
+		pawnHashKey ^= ZOBRIST.psq[piece][sq];
+	psq -= PSQT.values[piece][sq];
+	phase -= PHASE_WEIGHTS[pieceKind(piece)];
+	if (NNUE.loaded())
+		NNUE.removePiece(accumulator, piece, sq);
+}
+
+void Position::movePiece(int from, int to)
+{
+	PieceType piece = board[from];
+	Bitboard fromTo = squareBB(from) | squareBB(to);
+	board[from] = EMPTY;
+	board[to] = piece;
+	pieceBB[piece] ^= fromTo;
+	colorBB[pieceColor(piece)] ^= fromTo;
+	occupiedBB ^= fromTo;
+	hashKey ^= ZOBRIST.psq[piece][from] ^ ZOBRIST.psq[piece][to];
+	if (pieceKind(piece) == PAWN)
+		pawnHashKey ^= ZOBRIST.psq[piece][from] ^ ZOBRIST.psq[piece][to];
+	psq += PSQT.values[piece][to] - PSQT.values[piece][from];
+	if (NNUE.loaded())
+		NNUE.movePiece(accumulator, piece, from, to);
+}
+
+void Position::refreshAccumulator()
+{
+	if (!NNUE.loaded())
+		return;
+
+	NNUE.reset(accumulator);
+	Bitboard pieces = occupiedBB;
+	while (pieces)
+	{
+		int sq = popLsb(pieces);
+		NNUE.addPiece(accumulator, board[sq], sq);
+	}
+}
+
+Bitboard Position::attackersTo(int sq, Bitboard occupancy) const
+{
+	Bitboard bishopsQueens = pieceBB[WHITE_BISHOP] | pieceBB[BLACK_BISHOP] | pieceBB[WHITE_QUEEN] | pieceBB[BLACK_QUEEN];
+	Bitboard rooksQueens = pieceBB[WHITE_ROOK] | pieceBB[BLACK_ROOK] | pieceBB[WHITE_QUEEN] | pieceBB[BLACK_QUEEN];
+
+	return (pawnAttacks(BLACK, sq) & pieceBB[WHITE_PAWN]) | (pawnAttacks(WHITE, sq) & pieceBB[BLACK_PAWN]) | (knightAttacks(sq) & (pieceBB[WHITE_KNIGHT] | pieceBB[BLACK_KNIGHT])) | (kingAttacks(sq) & (pieceBB[WHITE_KING] | pieceBB[BLACK_KING])) | (bishopAttacks(sq, occupancy) & bishopsQueens) | (rookAttacks(sq, occupancy) & rooksQueens);
+}
+
+bool Position::isAttacked(int sq, Color by) const
+{
+	return (attackersTo(sq, occupiedBB) & colorBB[by]) != 0;
+}
+
+bool Position::inCheck() const
+{
+	return isAttacked(kingSquare(side), ~side);
+}
+
+// Function to play out the captures on to, starting with attacker taking a piece worth captured.
+// occupancy already has the first attacker lifted off. Each side recaptures with its least
+// valuable piece; sliders lined up behind a capturer join in once it has gone
+int Position::exchange(int from, int to, int captured, PieceKind attacker, Bitboard occupancy) const
+{
+	const Bitboard bishopsQueens = pieceBB[WHITE_BISHOP] | pieceBB[BLACK_BISHOP] | pieceBB[WHITE_QUEEN] | pieceBB[BLACK_QUEEN];
+	const Bitboard rooksQueens = pieceBB[WHITE_ROOK] | pieceBB[BLACK_ROOK] | pieceBB[WHITE_QUEEN] | pieceBB[BLACK_QUEEN];
+
+	int gain[32];
+	int depth = 0;
+	Color stm = pieceColor(board[from]);
+	Bitboard attackers = attackersTo(to, occupancy) & occupancy;
+	gain[0] = captured;
+
+	while (true)
+	{
+		depth++;
+		// Score if the piece now standing on to is taken in turn
+		gain[depth] = SEE_VALUES[attacker] - gain[depth - 1];
+		// Neither side can come out ahead by carrying on
+		if (std::max(-gain[depth - 1], gain[depth]) < 0 || depth == 31)
+			break;
+
+		stm = ~stm;
+		Bitboard ours = attackers & colorBB[stm];
+		if (!ours)
+			break;
+
+		PieceKind kind = KING;
+		for (PieceKind candidate : CHEAPEST_FIRST)
+		{
+			if (ours & pieceBB[makePiece(stm, candidate)])
+			{
+				kind = candidate;
+				break;
+			}
+		}
+
+		// The king may only take last
+		if (kind == KING && (attackers & colorBB[~stm]))
+			break;
+
+		occupancy ^= squareBB(lsb(ours & pieceBB[makePiece(stm, kind)]));
+		attackers |= (bishopAttacks(to, occupancy) & bishopsQueens) | (rookAttacks(to, occupancy) & rooksQueens);
+		attackers &= occupancy;
+		attacker = kind;
+	}
+
+	// The last entry assumed a recapture that never happened
+	while (--depth)
+		gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+	return gain[0];
+}
+
+int Position::see(Move move) const
+{
+	const int from = moveFrom(move);
+	const int to = moveTo(move);
+	PieceKind attacker = pieceKind(board[from]);
+	Bitboard occupancy = occupiedBB ^ squareBB(from);
+	int captured = SEE_VALUES[pieceKind(board[to])];
+
+	if (moveFlags(move) == EP_CAPTURE)
+	{
+		captured = SEE_VALUES[PAWN];
+		occupancy ^= squareBB(to + (side == WHITE ? -8 : 8));
+	}
+	if (isPromotion(move))
+	{
+		captured += SEE_VALUES[promotionKind(move)] - SEE_VALUES[PAWN];
+		attacker = promotionKind(move);
+	}
+
+	return exchange(from, to, captured, attacker, occupancy);
+}
+
+bool Position::losesExchange(Move move) const
+{
+	if (moveFlags(move) == EP_CAPTURE || isPromotion(move))
+		return see(move) < 0;
+	if (SEE_VALUES[pieceKind(board[moveTo(move)])] >= SEE_VALUES[pieceKind(board[moveFrom(move)])])
+		return false;
+	return see(move) < 0;
+}
+
+Bitboard Position::hangingPieces(Color color) const
+{
+	Bitboard hanging = 0;
+	Bitboard targets = colorBB[color] & ~pieceBB[makePiece(color, KING)];
+
+	while (targets)
+	{
+		int sq = popLsb(targets);
+		Bitboard attackers = attackersTo(sq, occupiedBB) & colorBB[~color];
+		if (!attackers)
+			continue;
+
+		// Capture with the least valuable attacker first, as the exchange itself would
+		int from = lsb(attackers);
+		for (PieceKind kind : CHEAPEST_FIRST)
+		{
+			Bitboard byKind = attackers & pieceBB[makePiece(~color, kind)];
+			if (byKind)
+			{
+				from = lsb(byKind);
+				break;
+			}
+		}
+
+		if (exchange(from, sq, SEE_VALUES[pieceKind(board[sq])], pieceKind(board[from]), occupiedBB ^ squareBB(from)) > 0)
+			hanging |= squareBB(sq);
+	}
+	return hanging;
+}
+
+// Function to find our pieces that are the only blocker between our king and an enemy slider
+Bitboard Position::pinnedPieces(Color color) const
+{
+	int ksq = kingSquare(color);
+	Color them = ~color;
+	Bitboard snipers = (rookAttacks(ksq, 0) & (pieces(them, ROOK) | pieces(them, QUEEN))) | (bishopAttacks(ksq, 0) & (pieces(them, BISHOP) | pieces(them, QUEEN)));
+	Bitboard pinned = 0;
+
+	while (snipers)
+	{
+		Bitboard blockers = betweenBB(ksq, popLsb(snipers)) & occupiedBB;
+		if (blockers && !moreThanOne(blockers))
+			pinned |= blockers & colorBB[color];
+	}
+	return pinned;
+}
+
+static void addPromotions(MoveList &list, int from, int to, int captureFlag)
+{
+	list.add(encodeMove(from, to, PROMOTION | captureFlag | 3));
+	list.add(encodeMove(from, to, PROMOTION | captureFlag | 0));
+	list.add(encodeMove(from, to, PROMOTION | captureFlag | 2));
+	list.add(encodeMove(from, to, PROMOTION | captureFlag | 1));
+}
+
+template <GenType Type>
+void Position::generate(MoveList &list) const
+{
+	const Color us = side;
+	const Color them = ~us;
+	const int ksq = kingSquare(us);
+	const Bitboard ours = colorBB[us];
+	const Bitboard theirs = colorBB[them];
+	const Bitboard empty = ~occupiedBB;
+
+	Bitboard targets = Type == GEN_CAPTURES ? theirs : Type == GEN_QUIETS ? empty : ~ours;
+	Bitboard checkers = attackersTo(ksq, occupiedBB) & theirs;
+
+	// King moves, checked against attacks with the king lifted off the board so sliders see through it
+	Bitboard occupancyWithoutKing = occupiedBB ^ squareBB(ksq);
+	Bitboard kingTargets = kingAttacks(ksq) & targets;
+	while (kingTargets)
+	{
+		int to = popLsb(kingTargets);
+		if (!(attackersTo(to, occupancyWithoutKing) & theirs))
+			list.add(encodeMove(ksq, to, board[to] != EMPTY ? CAPTURE : QUIET));
+	}
+
+	// Only the king can escape a double check
+	if (moreThanOne(checkers))
+		return;
+
+	// Non king moves must capture the checker or block its ray
+	Bitboard checkMask = checkers ? betweenBB(ksq, lsb(checkers)) | checkers : ~0ULL;
+	Bitboard pinned = pinnedPieces(us);
+
+	if (Type != GEN_CAPTURES && !checkers)
+	{
+		int kingSide = us == WHITE ? WHITE_OO : BLACK_OO;
+		int queenSide = us == WHITE ? WHITE_OOO : BLACK_OOO;
+		int rank = us == WHITE ? 0 : 7;
+		PieceType rook = makePiece(us, ROOK);
+
+		if ((castlingRights & kingSide) && board[makeSquare(7, rank)] == rook && !(occupiedBB & (squareBB(makeSquare(5, rank)) | squareBB(makeSquare(6, rank)))) && !isAttacked(makeSquare(5, rank), them) && !isAttacked(makeSquare(6, rank), them))
+			list.add(encodeMove(ksq, makeSquare(6, rank), KING_CASTLE));
+
+		if ((castlingRights & queenSide) && board[makeSquare(0, rank)] == rook && !(occupiedBB & (squareBB(makeSquare(1, rank)) | squareBB(makeSquare(2, rank)) | squareBB(makeSquare(3, rank)))) && !isAttacked(makeSquare(2, rank), them) && !isAttacked(makeSquare(3, rank), them))
+			list.add(encodeMove(ksq, makeSquare(2, rank), QUEEN_CASTLE));
+	}
+
+	// Knights, bishops, rooks and queens. A pinned piece may only slide along the pin line
+	Bitboard movers = ours & ~pieceBB[makePiece(us, PAWN)] & ~pieceBB[makePiece(us, KING)];
+	while (movers)
+	{
+		int from = popLsb(movers);
+		PieceKind kind = pieceKind(board[from]);
+		Bitboard attacks;
+
+		if (kind == KNIGHT)
+			attacks = (pinned & squareBB(from)) ? 0 : knightAttacks(from);
+		else if (kind == BISHOP)
+			attacks = bishopAttacks(from, occupiedBB);
+		else if (kind == ROOK)
+			attacks = rookAttacks(from, occupiedBB);
+		else
+			attacks = queenAttacks(from, occupiedBB);
+
+		attacks &= targets & checkMask;
+		if (pinned & squareBB(from))
+			attacks &= lineBB(ksq, from);
+
+		while (attacks)
+		{
+			int to = popLsb(attacks);
+			list.add(encodeMove(from, to, board[to] != EMPTY ? CAPTURE : QUIET));
+		}
+	}
+
+	// Pawns
+	const int up = us == WHITE ? 8 : -8;
+	const Bitboard startRank = us == WHITE ? RANK_2_BB : RANK_7_BB;
+	const Bitboard lastRank = us == WHITE ? RANK_8_BB : RANK_1_BB;
+
+	Bitboard pawns = pieceBB[makePiece(us, PAWN)];
+	while (pawns)
+	{
+		int from = popLsb(pawns);
+		Bitboard allowed = checkMask;
+		if (pinned & squareBB(from))
+			allowed &= lineBB(ksq, from);
+
+		Bitboard pushes = 0;
+		int single = from + up;
+		if (board[single] == EMPTY)
+		{
+			pushes |= squareBB(single);
+			if ((startRank & squareBB(from)) && board[single + up] == EMPTY)
+				pushes |= squareBB(single + up);
+		}
+		pushes &= allowed;
+
+		Bitboard captures = pawnAttacks(us, from) & theirs & allowed;
+
+		while (pushes)
+		{
+			int to = popLsb(pushes);
+			if (squareBB(to) & lastRank)
+			{
+				if (Type != GEN_QUIETS)
+					addPromotions(list, from, to, 0);
+			}
+			else if (Type != GEN_CAPTURES)
+				list.add(encodeMove(from, to, to == single ? QUIET : DOUBLE_PAWN_PUSH));
+		}
+
+		if (Type != GEN_QUIETS)
+		{
+			while (captures)
+			{
+				int to = popLsb(captures);
+				if (squareBB(to) & lastRank)
+					addPromotions(list, from, to, CAPTURE);
+				else
+					list.add(encodeMove(from, to, CAPTURE));
+			}
+
+			// En passant is verified by replaying the occupancy change, which also covers the
+			// rank pin where both pawns leave the king's rank at once
+			if (epSquare != SQ_NONE && (pawnAttacks(us, from) & squareBB(epSquare)))
+			{
+				int capturedSq = epSquare - up;
+				Bitboard occupancy = (occupiedBB ^ squareBB(from) ^ squareBB(capturedSq)) | squareBB(epSquare);
+				if (!(attackersTo(ksq, occupancy) & theirs & ~squareBB(capturedSq)))
+					list.add(encodeMove(from, epSquare, EP_CAPTURE));
+			}
+		}
+	}
+}
+
+template void Position::generate<GEN_ALL>(MoveList &list) const;
+template void Position::generate<GEN_CAPTURES>(MoveList &list) const;
+template void Position::generate<GEN_QUIETS>(MoveList &list) const;
+
+Move Position::findMove(int from, int to, PieceKind promotion) const
+{
+	MoveList list;
+	generateLegalMoves(list);
+	for (Move move : list)
+	{
+		if (moveFrom(move) != from || moveTo(move) != to)
+			continue;
+		if (isPromotion(move) && promotionKind(move) != promotion)
+			continue;
+		return move;
+	}
+	return MOVE_NONE;
+}
+
+bool Position::isLegal(Move move) const
+{
+	if (move == MOVE_NONE)
+		return false;
+
+	const int from = moveFrom(move);
+	const int to = moveTo(move);
+	const int flags = moveFlags(move);
+	const Color us = side;
+	const Color them = ~us;
+	const PieceType piece = board[from];
+
+	if (piece == EMPTY || pieceColor(piece) != us || (colorBB[us] & squareBB(to)))
+		return false;
+
+	// Castling and en passant are rare, leave them to the generator
+	if (flags == KING_CASTLE || flags == QUEEN_CASTLE || flags == EP_CAPTURE)
+	{
+		MoveList list;
+		if (flags == EP_CAPTURE)
+			generate<GEN_CAPTURES>(list);
+		else
+			generate<GEN_QUIETS>(list);
+		for (Move legal : list)
+		{
+			if (legal == move)
+				return true;
+		}
+		return false;
+	}
+
+	// The capture flag has to agree with the board
+	if (bool(flags & CAPTURE) != (board[to] != EMPTY))
+		return false;
+
+	const PieceKind kind = pieceKind(piece);
+	const int ksq = kingSquare(us);
+
+	if (kind == PAWN)
+	{
+		const int up = us == WHITE ? 8 : -8;
+		const Bitboard lastRank = us == WHITE ? RANK_8_BB : RANK_1_BB;
+
+		if (isPromotion(move) != bool(lastRank & squareBB(to)))
+			return false;
+		if (!isPromotion(move) && flags != QUIET && flags != DOUBLE_PAWN_PUSH && flags != CAPTURE)
+			return false;
+		if (flags & CAPTURE)
+		{
+			if (!(pawnAttacks(us, from) & squareBB(to)))
+				return false;
+		}
+		else if (flags == DOUBLE_PAWN_PUSH)
+		{
+			if (!((us == WHITE ? RANK_2_BB : RANK_7_BB) & squareBB(from)) || to != from + 2 * up || board[from + up] != EMPTY)
+				return false;
+		}
+		else if (to != from + up)
+			return false;
+	}
+	else
+	{
+		if (flags != QUIET && flags != CAPTURE)
+			return false;
+
+		Bitboard attacks;
+		if (kind == KNIGHT)
+			attacks = knightAttacks(from);
+		else if (kind == BISHOP)
+			attacks = bishopAttacks(from, occupiedBB);
+		else if (kind == ROOK)
+			attacks = rookAttacks(from, occupiedBB);
+		else if (kind == QUEEN)
+			attacks = queenAttacks(from, occupiedBB);
+		else
+			attacks = kingAttacks(from);
+		if (!(attacks & squareBB(to)))
+			return false;
+
+		if (kind == KING)
+			return !(attackersTo(to, occupiedBB ^ squareBB(from)) & colorBB[them]);
+	}
+
+	// Same rules as the generator: answer a single check, stay on the pin line
+	Bitboard checkers = attackersTo(ksq, occupiedBB) & colorBB[them];
+	if (checkers)
+	{
+		if (moreThanOne(checkers) || !((betweenBB(ksq, lsb(checkers)) | checkers) & squareBB(to)))
+			return false;
+	}
+	return !(pinnedPieces(us) & squareBB(from)) || (lineBB(ksq, from) & squareBB(to));
+}
+
+void Position::makeMove(Move move, UndoInfo &undo)
+{
+	const int from = moveFrom(move);
+	const int to = moveTo(move);
+	const int flags = moveFlags(move);
+	const Color us = side;
+	const PieceType piece = board[from];
+
+	undo.castlingRights = castlingRights;
+	undo.epSquare = epSquare;
+	undo.halfmoveClock = halfmoveClock;
+	undo.captured = EMPTY;
+	undo.key = hashKey;
+
+	halfmoveClock++;
+	if (epSquare != SQ_NONE)
+		hashKey ^= ZOBRIST.enPassant[fileOf(epSquare)];
+	epSquare = SQ_NONE;
+
+	if (flags == EP_CAPTURE)
+	{
+		int capturedSq = us == WHITE ? to - 8 : to + 8;
+		undo.captured = board[capturedSq];
+		removePiece(capturedSq);
+	}
+	else if (flags & CAPTURE)
+	{
+		undo.captured = board[to];
+		removePiece(to);
+	}
+
+	movePiece(from, to);
+
+	if (pieceKind(piece) == PAWN || undo.captured != EMPTY)
+		halfmoveClock = 0;
+
+	if (flags & PROMOTION)
+	{
+		removePiece(to);
+		putPiece(makePiece(us, promotionKind(move)), to);
+	}
+	else if (flags == DOUBLE_PAWN_PUSH)
+	{
+		// Only record the square when an enemy pawn can actually take en passant
+		int passed = (from + to) / 2;
+		if (pawnAttacks(us, passed) & pieceBB[makePiece(~us, PAWN)])
+		{
+			epSquare = passed;
+			hashKey ^= ZOBRIST.enPassant[fileOf(passed)];
+		}
+	}
+	else if (flags == KING_CASTLE)
+		movePiece(to + 1, to - 1);
+	else if (flags == QUEEN_CASTLE)
+		movePiece(to - 2, to + 1);
+
+	int rights = castlingRights & CastlingMask[from] & CastlingMask[to];
+	if (rights != castlingRights)
+	{
+		hashKey ^= ZOBRIST.castling[castlingRights] ^ ZOBRIST.castling[rights];
+		castlingRights = rights;
+	}
+
+	if (us == BLACK)
+		fullmoveNumber++;
+	side = ~us;
+	hashKey ^= ZOBRIST.side;
+
+	// Start loading the child's table bucket while the caller generates its moves
+	TT.prefetch(hashKey);
+}
+
+void Position::unmakeMove(Move move, const UndoInfo &undo)
+{
+	const int from = moveFrom(move);
+	const int to = moveTo(move);
+	const int flags = moveFlags(move);
+
+	side = ~side;
+	const Color us = side;
+	if (us == BLACK)
+		fullmoveNumber--;
+
+	if (flags & PROMOTION)
+	{
+		removePiece(to);
+		putPiece(makePiece(us, PAWN), to);
+	}
+	else if (flags == KING_CASTLE)
+		movePiece(to - 1, to + 1);
+	else if (flags == QUEEN_CASTLE)
+		movePiece(to + 1, to - 2);
+
+	movePiece(to, from);
+
+	if (flags == EP_CAPTURE)
+		putPiece(undo.captured, us == WHITE ? to - 8 : to + 8);
+	else if (flags & CAPTURE)
+		putPiece(undo.captured, to);
+
+	castlingRights = undo.castlingRights;
+	epSquare = undo.epSquare;
+	halfmoveClock = undo.halfmoveClock;
+	hashKey = undo.key;
+}
+
+void Position::makeNullMove(UndoInfo &undo)
+{
+	undo.castlingRights = castlingRights;
+	undo.epSquare = epSquare;
+	undo.halfmoveClock = halfmoveClock;
+	undo.captured = EMPTY;
+	undo.key = hashKey;
+
+	if (epSquare != SQ_NONE)
+		hashKey ^= ZOBRIST.enPassant[fileOf(epSquare)];
+	epSquare = SQ_NONE;
+	halfmoveClock++;
+	side = ~side;
+	hashKey ^= ZOBRIST.side;
+	TT.prefetch(hashKey);
+}
+
+void Position::unmakeNullMove(const UndoInfo &undo)
+{
+	side = ~side;
+	epSquare = undo.epSquare;
+	halfmoveClock = undo.halfmoveClock;
+	hashKey = undo.key;
+}
+
+std::string squareName(int sq)
+{
+	return std::string(1, char('a' + fileOf(sq))) + char('1' + rankOf(sq));
+}
+
+std::string moveToUci(Move move)
+{
+	if (move == MOVE_NONE)
+		return "0000";
+
+	std::string text = squareName(moveFrom(move)) + squareName(moveTo(move));
+	if (isPromotion(move))
+		text += PIECE_CHARS[promotionKind(move)];
+	return text;
+}
+
+Move moveFromUci(const Position &position, const std::string &text)
+{
+	if (text.size() < 4 || text.size() > 5)
+		return MOVE_NONE;
+	for (int i = 0; i < 4; i += 2)
+	{
+		if (text[i] < 'a' || text[i] > 'h' || text[i + 1] < '1' || text[i + 1] > '8')
+			return MOVE_NONE;
+	}
+
+	int from = makeSquare(text[0] - 'a', text[1] - '1');
+	int to = makeSquare(text[2] - 'a', text[3] - '1');
+	PieceKind promotion = QUEEN;
+	if (text.size() == 5)
+	{
+		const char *found = std::strchr(PIECE_CHARS, text[4]);
+		if (!found || text[4] == ' ' || found - PIECE_CHARS < ROOK || found - PIECE_CHARS > QUEEN)
+			return MOVE_NONE;
+		promotion = PieceKind(found - PIECE_CHARS);
+	}
+
+	Move move = position.findMove(from, to, promotion);
+	// A missing promotion letter is not a queen promotion
+	if (move != MOVE_NONE && isPromotion(move) != (text.size() == 5))
+		return MOVE_NONE;
+	return move;
+}
+
+std::string moveToSan(const Position &position, Move move)
+{
+	int from = moveFrom(move), to = moveTo(move);
+	PieceKind kind = pieceKind(position.pieceOn(from));
+	std::string text;
+
+	if (moveFlags(move) == KING_CASTLE)
+		text = "O-O";
+	else if (moveFlags(move) == QUEEN_CASTLE)
+		text = "O-O-O";
+	else if (kind == PAWN)
+	{
+		if (isCapture(move))
+			text = std::string(1, char('a' + fileOf(from))) + 'x';
+		text += squareName(to);
+		if (isPromotion(move))
+			text += std::string("=") + char(std::toupper(PIECE_CHARS[promotionKind(move)]));
+	}
+	else
+	{
+		text = char(std::toupper(PIECE_CHARS[kind]));
+
+		// Name the file, else the rank, else both when another piece of the same kind can go there too
+		MoveList moves;
+		position.generateLegalMoves(moves);
+		bool ambiguous = false, sameFile = false, sameRank = false;
+		for (Move other : moves)
+		{
+			int otherFrom = moveFrom(other);
+			if (other == move || moveTo(other) != to || otherFrom == from || pieceKind(position.pieceOn(otherFrom)) != kind)
+				continue;
+			ambiguous = true;
+			sameFile |= fileOf(otherFrom) == fileOf(from);
+			sameRank |= rankOf(otherFrom) == rankOf(from);
+		}
+		if (ambiguous && (!sameFile || sameRank))
+			text += char('a' + fileOf(from));
+		if (ambiguous && sameFile)
+			text += char('1' + rankOf(from));
+		if (isCapture(move))
+			text += 'x';
+		text += squareName(to);
+	}
+
+	Position after = position;
+	UndoInfo undo;
+	after.makeMove(move, undo);
+	if (after.inCheck())
+	{
+		MoveList replies;
+		after.generateLegalMoves(replies);
+		text += replies.size() == 0 ? '#' : '+';
+	}
+	return text;
+}
+
+Move moveFromSan(const Position &position, const std::string &text)
+{
+	std::string wanted = text;
+	while (!wanted.empty() && std::strchr("+#!?", wanted.back()))
+		wanted.pop_back();
+	// Castling is sometimes written with zeros
+	if (wanted == "0-0" || wanted == "0-0-0")
+		std::replace(wanted.begin(), wanted.end(), '0', 'O');
+	if (wanted.empty())
+		return MOVE_NONE;
+
+	MoveList moves;
+	position.generateLegalMoves(moves);
+	for (Move move : moves)
+	{
+		std::string san = moveToSan(position, move);
+		while (san.back() == '+' || san.back() == '#')
+			san.pop_back();
+		if (san == wanted)
+			return move;
+	}
+	return MOVE_NONE;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <string>
+
+#include "bitboard.h"
+#include "nnue.h"
+#include "psqt.h"
+#include "types.h"
+
+const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Irreversible state saved by makeMove so unmakeMove can restore it
+struct UndoInfo
+{
+	int castlingRights;
+	int epSquare;
+	int halfmoveClock;
+	PieceType captured;
+	uint64_t key;
+};
+
+enum GenType
+{
+	GEN_ALL,
+	GEN_CAPTURES, // captures and promotions
+	GEN_QUIETS	  // everything else, including castling
+};
+
+// Bitboard board: one bitboard per PieceType plus occupancy per color
+class Position
+{
+public:
+	Position();
+
+	void clear();
+	void setStartPosition();
+	// Returns false and leaves the position untouched when the FEN is malformed
+	bool setFromFen(const std::string &fen);
+	std::string fen() const;
+	// Sets up count pieces, pieces[i] on squares[i], with no castling or en passant rights. Cheaper
+	// than a FEN for code that builds millions of positions (the tablebase generator). Returns false
+	// when they do not make a legal position, the board is then left in an unspecified state
+	bool setFromPieces(const PieceType pieces[], const int squares[], int count, Color toMove);
+
+	PieceType pieceOn(int sq) const { return board[sq]; }
+	Bitboard pieces(PieceType piece) const { return pieceBB[piece]; }
+	Bitboard pieces(Color color) const { return colorBB[color]; }
+	Bitboard pieces(Color color, PieceKind kind) const { return pieceBB[makePiece(color, kind)]; }
+	Bitboard occupied() const { return occupiedBB; }
+	Color sideToMove() const { return side; }
+	int castling() const { return castlingRights; }
+	int enPassantSquare() const { return epSquare; }
+	int halfmoves() const { return halfmoveClock; }
+	int fullmoves() const { return fullmoveNumber; }
+	// Zobrist key, kept up to date by every piece change, make and unmake
+	uint64_t key() const { return hashKey; }
+	// Zobrist key of the pawns alone, for the pawn structure cache
+	uint64_t pawnKey() const { return pawnHashKey; }
+	int kingSquare(Color color) const { return lsb(pieceBB[makePiece(color, KING)]); }
+	// Material and piece-square score from white's point of view, kept up to date like the key
+	Score psqScore() const { return psq; }
+	// Sum of PHASE_WEIGHTS over the pieces on the board, MAX_PHASE or more at the start
+	int gamePhase() const { return phase; }
+	// Network hidden layer, kept up to date by every piece change while a network is loaded
+	const Accumulator &nnueAccumulator() const { return accumulator; }
+	// Rebuilds the accumulator from the board, for positions set up before the network was loaded
+	void refreshAccumulator();
+
+	Bitboard attackersTo(int sq, Bitboard occupancy) const;
+	bool isAttacked(int sq, Color by) const;
+	bool inCheck() const;
+
+	// Static exchange evaluation: material the mover wins with move (a capture) if both sides keep
+	// recapturing on the target square with their least valuable piece and stop once behind.
+	// Pins are ignored. Quiet moves score what is lost if the moved piece gets taken
+	int see(Move move) const;
+	// Same as see(move) < 0, without playing out the exchange when the capturer is worth no more than its victim
+	bool losesExchange(Move move) const;
+	// Pieces of color the opponent could win material on by capturing them right now
+	Bitboard hangingPieces(Color color) const;
+
+	// Generates strictly legal moves for the side to move
+	template <GenType Type>
+	void generate(MoveList &list) const;
+	void generateLegalMoves(MoveList &list) const { generate<GEN_ALL>(list); }
+
+	// Legal move from -> to, or MOVE_NONE. Promotions use the given piece kind
+	Move findMove(int from, int to, PieceKind promotion = QUEEN) const;
+	// Checks a move that did not come from this position's generator, like a hash table move or a
+	// killer from a sibling node. Cheaper than generating every move and searching the list
+	bool isLegal(Move move) const;
+
+	void makeMove(Move move, UndoInfo &undo);
+	void unmakeMove(Move move, const UndoInfo &undo);
+	// Passes the turn, used by null move pruning
+	void makeNullMove(UndoInfo &undo);
+	void unmakeNullMove(const UndoInfo &undo);
+
+	// True when the side to move has something besides pawns and king
+	bool hasNonPawnMaterial(Color color) const { return (colorBB[color] & ~pieces(color, PAWN) & ~pieces(color, KING)) != 0; }
+	// Neither side can ever mate: kings alone, or with a single knight or bishop between them
+	bool isInsufficientMaterial() const;
+
+	void putPiece(PieceType piece, int sq);
+	void removePiece(int sq);
+
+private:
+	void movePiece(int from, int to);
+	Bitboard pinnedPieces(Color color) const;
+	int exchange(int from, int to, int captured, PieceKind attacker, Bitboard occupancy) const;
+	bool isValid() const;
+
+	PieceType board[64];
+	Bitboard pieceBB[13];
+	Bitboard colorBB[2];
+	Bitboard occupiedBB;
+	Color side;
+	int castlingRights;
+	int epSquare;
+	int halfmoveClock;
+	int fullmoveNumber;
+	uint64_t hashKey;
+	uint64_t pawnHashKey;
+	Score psq;
+	int phase;
+	Accumulator accumulator;
+};
+
+// Square and move names in coordinate notation (e4, e7e8q)
+std::string squareName(int sq);
+std::string moveToUci(Move move);
+// Legal move of position written as moveToUci would, or MOVE_NONE
+Move moveFromUci(const Position &position, const std::string &text);
+// Standard algebraic notation (Nbd7, exd6, O-O, e8=Q+) of a legal move, as PGN writes it
+std::string moveToSan(const Position &position, Move move);
+// Legal move of position written in SAN, or MOVE_NONE. Check marks and annotations (+ # ! ?) are optional
+Move moveFromSan(const Position &position, const std::string &text);
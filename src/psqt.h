@@ -0,0 +1,144 @@
+#pragma once
+
+#include "types.h"
+
+// Middlegame and endgame halves of a score, blended by game phase at the leaf
+struct Score
+{
+	int mg;
+	int eg;
+
+	constexpr Score operator+(Score other) const { return {mg + other.mg, eg + other.eg}; }
+	constexpr Score operator-(Score other) const { return {mg - other.mg, eg - other.eg}; }
+	Score &operator+=(Score other)
+	{
+		mg += other.mg;
+		eg += other.eg;
+		return *this;
+	}
+	Score &operator-=(Score other)
+	{
+		mg -= other.mg;
+		eg -= other.eg;
+		return *this;
+	}
+};
+
+// Material by PieceKind for each phase
+constexpr int PIECE_VALUE_MG[7] = {0, 100, 500, 320, 330, 900, 0};
+constexpr int PIECE_VALUE_EG[7] = {0, 120, 530, 290, 310, 950, 0};
+
+// How much each piece counts towards the middlegame, 24 with all pieces on the board
+constexpr int PHASE_WEIGHTS[7] = {0, 0, 2, 1, 1, 4, 0};
+constexpr int MAX_PHASE = 24;
+
+// Piece-square tables drawn as seen by white, a8 first. Black pieces read them mirrored
+constexpr int PAWN_TABLE[64] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	50, 50, 50, 50, 50, 50, 50, 50,
+	10, 10, 20, 30, 30, 20, 10, 10,
+	5, 5, 10, 25, 25, 10, 5, 5,
+	0, 0, 0, 20, 20, 0, 0, 0,
+	5, -5, -10, 0, 0, -10, -5, 5,
+	5, 10, 10, -20, -20, 10, 10, 5,
+	0, 0, 0, 0, 0, 0, 0, 0};
+
+// In the endgame every step towards promotion counts, wherever the pawn stands
+constexpr int PAWN_END_TABLE[64] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	80, 80, 80, 80, 80, 80, 80, 80,
+	50, 50, 50, 50, 50, 50, 50, 50,
+	30, 30, 30, 30, 30, 30, 30, 30,
+	15, 15, 15, 15, 15, 15, 15, 15,
+	5, 5, 5, 5, 5, 5, 5, 5,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0};
+
+constexpr int KNIGHT_TABLE[64] = {
+	-50, -40, -30, -30, -30, -30, -40, -50,
+	-40, -20, 0, 0, 0, 0, -20, -40,
+	-30, 0, 10, 15, 15, 10, 0, -30,
+	-30, 5, 15, 20, 20, 15, 5, -30,
+	-30, 0, 15, 20, 20, 15, 0, -30,
+	-30, 5, 10, 15, 15, 10, 5, -30,
+	-40, -20, 0, 5, 5, 0, -20, -40,
+	-50, -40, -30, -30, -30, -30, -40, -50};
+
+constexpr int BISHOP_TABLE[64] = {
+	-20, -10, -10, -10, -10, -10, -10, -20,
+	-10, 0, 0, 0, 0, 0, 0, -10,
+	-10, 0, 5, 10, 10, 5, 0, -10,
+	-10, 5, 5, 10, 10, 5, 5, -10,
+	-10, 0, 10, 10, 10, 10, 0, -10,
+	-10, 10, 10, 10, 10, 10, 10, -10,
+	-10, 5, 0, 0, 0, 0, 5, -10,
+	-20, -10, -10, -10, -10, -10, -10, -20};
+
+constexpr int ROOK_TABLE[64] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	5, 10, 10, 10, 10, 10, 10, 5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	0, 0, 0, 5, 5, 0, 0, 0};
+
+constexpr int QUEEN_TABLE[64] = {
+	-20, -10, -10, -5, -5, -10, -10, -20,
+	-10, 0, 0, 0, 0, 0, 0, -10,
+	-10, 0, 5, 5, 5, 5, 0, -10,
+	-5, 0, 5, 5, 5, 5, 0, -5,
+	0, 0, 5, 5, 5, 5, 0, -5,
+	-10, 5, 5, 5, 5, 5, 0, -10,
+	-10, 0, 5, 0, 0, 0, 0, -10,
+	-20, -10, -10, -5, -5, -10, -10, -20};
+
+constexpr int KING_TABLE[64] = {
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-20, -30, -30, -40, -40, -30, -30, -20,
+	-10, -20, -20, -20, -20, -20, -20, -10,
+	20, 20, 0, 0, 0, 0, 20, 20,
+	20, 30, 10, 0, 0, 10, 30, 20};
+
+// Once the queens are off the king should head for the centre
+constexpr int KING_END_TABLE[64] = {
+	-50, -40, -30, -20, -20, -30, -40, -50,
+	-30, -20, -10, 0, 0, -10, -20, -30,
+	-30, -10, 20, 30, 30, 20, -10, -30,
+	-30, -10, 30, 40, 40, 30, -10, -30,
+	-30, -10, 30, 40, 40, 30, -10, -30,
+	-30, -10, 20, 30, 30, 20, -10, -30,
+	-30, -30, 0, 0, 0, 0, -30, -30,
+	-50, -30, -30, -30, -30, -30, -30, -50};
+
+// Material plus square bonus for every PieceType on every square, positive for white and
+// negative for black, so a position's score is the plain sum over its pieces
+struct PsqTables
+{
+	Score values[13][64];
+};
+
+constexpr PsqTables makePsqTables()
+{
+	const int *const mgTables[7] = {nullptr, PAWN_TABLE, ROOK_TABLE, KNIGHT_TABLE, BISHOP_TABLE, QUEEN_TABLE, KING_TABLE};
+	const int *const egTables[7] = {nullptr, PAWN_END_TABLE, ROOK_TABLE, KNIGHT_TABLE, BISHOP_TABLE, QUEEN_TABLE, KING_END_TABLE};
+	PsqTables tables = {};
+
+	for (int kind = PAWN; kind <= KING; kind++)
+	{
+		for (int sq = 0; sq < 64; sq++)
+		{
+			Score white = {PIECE_VALUE_MG[kind] + mgTables[kind][sq ^ 56], PIECE_VALUE_EG[kind] + egTables[kind][sq ^ 56]};
+			Score black = {PIECE_VALUE_MG[kind] + mgTables[kind][sq], PIECE_VALUE_EG[kind] + egTables[kind][sq]};
+			tables.values[makePiece(WHITE, PieceKind(kind))][sq] = white;
+			tables.values[makePiece(BLACK, PieceKind(kind))][sq] = {-black.mg, -black.eg};
+		}
+	}
+	return tables;
+}
+
+constexpr PsqTables PSQT = makePsqTables();
@@ -0,0 +1,604 @@
+#include "search.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+#include "evaluate.h"
+#include "gamestate.h"
+#include "movepick.h"
+#include "tablebase.h"
+#include "tt.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Positional swing a capture in the quiescence search may still bring on top of the material
+const int DELTA_MARGIN = 200;
+
+// Late move reductions grow with both the remaining depth and how late the move comes
+static struct ReductionTable
+{
+	int values[64][64];
+
+	ReductionTable()
+	{
+		for (int depth = 0; depth < 64; depth++)
+		{
+			for (int count = 0; count < 64; count++)
+				values[depth][count] = depth && count ? int(0.75 + std::log(double(depth)) * std::log(double(count)) / 2.25) : 0;
+		}
+	}
+
+	int get(int depth, int count) const { return values[std::min(depth, 63)][std::min(count, 63)]; }
+} Reductions;
+
+// Mate scores are stored relative to the node so they stay correct when reached through another path
+static int scoreToTT(int score, int ply)
+{
+	return score >= VALUE_MATE_IN_MAX_PLY ? score + ply : score <= -VALUE_MATE_IN_MAX_PLY ? score - ply : score;
+}
+
+static int scoreFromTT(int score, int ply)
+{
+	return score >= VALUE_MATE_IN_MAX_PLY ? score - ply : score <= -VALUE_MATE_IN_MAX_PLY ? score + ply : score;
+}
+
+static_assert(MAX_MATE_PLIES >= MAX_PLY + 2 * TB_MAX_MATE, "tablebase mates must score inside the mate range");
+
+// Endgame tables count full moves to mate from the node, the search counts plies from the root
+static int tablebaseScore(const TbResult &result, int ply)
+{
+	if (result.wdl > 0)
+		return VALUE_MATE - ply - (2 * result.movesToMate - 1);
+	if (result.wdl < 0)
+		return -VALUE_MATE + ply + 2 * result.movesToMate;
+	return VALUE_DRAW;
+}
+
+// The tables ignore the fifty move rule, so a win or loss only holds when the mate comes before the
+// clock runs out. Otherwise the position is searched like any other
+static bool isTablebaseResultExact(const TbResult &result, int halfmoves)
+{
+	int pliesToMate = result.wdl > 0 ? 2 * result.movesToMate - 1 : 2 * result.movesToMate;
+	return result.wdl == 0 || halfmoves + pliesToMate <= 100;
+}
+
+// Lazy SMP helpers skip some iterations so the threads spread over different depths
+// instead of all searching the same tree in lockstep
+static const int SKIP_SIZE[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int SKIP_PHASE[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+class SearchWorker;
+typedef std::vector<std::unique_ptr<SearchWorker>> WorkerPool;
+
+// State of one search thread: its own copy of the position plus everything the tree walk needs.
+// The only thing shared between workers is the transposition table (and the stop flag)
+class alignas(64) SearchWorker
+{
+public:
+	SearchWorker(int id, const Position &root, const std::vector<uint64_t> &history, const SearchLimits &limits, std::atomic<bool> &stop, const std::atomic<bool> &pondering, const WorkerPool &pool, PawnTable &pawns)
+		: id(id), game(root, history), position(game.position()), limits(limits), stop(stop), pondering(pondering), pool(pool), pawns(pawns)
+	{
+		game.refreshAccumulator();
+		start = Clock::now();
+		setTimeBudget();
+	}
+
+	SearchResult iterate(const std::function<void(const SearchResult &)> &onIteration);
+	uint64_t nodeCount() const { return nodes.load(std::memory_order_relaxed); }
+	uint64_t cutoffCount() const { return cutoffs; }
+	uint64_t firstMoveCutoffCount() const { return firstMoveCutoffs; }
+	uint64_t tbHitCount() const { return tbHits; }
+	const PawnTable &pawnTable() const { return pawns; }
+
+private:
+	int search(int alpha, int beta, int depth, int ply, bool nullAllowed);
+	int quiescence(int alpha, int beta, int ply);
+	void updateQuietStats(Move move, int ply, int depth, const Move quietsTried[], int quietCount);
+	bool shouldStop();
+	int64_t elapsed() const { return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count(); }
+	void setTimeBudget();
+	uint64_t totalNodes() const;
+
+	// Only this thread writes its counter, so a plain load and store is enough for others to read it
+	void countNode() { nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+	void makeMove(Move move, int ply)
+	{
+		currentMove[ply] = move;
+		movedPiece[ply] = position.pieceOn(moveFrom(move));
+		game.makeMove(move);
+	}
+
+	const int id;
+	// The moves of the current line are made and taken back on the game's stack, position is its board
+	GameState game;
+	const Position &position;
+	const SearchLimits &limits;
+	std::atomic<bool> &stop;
+	const std::atomic<bool> &pondering;
+	const WorkerPool &pool;
+	bool stopped = false;
+
+	Clock::time_point start;
+	int64_t optimumTime = 0;
+	int64_t maximumTime = 0;
+
+	std::atomic<uint64_t> nodes{0};
+	int selDepth = 0;
+	Move pv[MAX_PLY][MAX_PLY];
+	int pvLength[MAX_PLY];
+
+	// Move ordering state, local to this thread
+	Move currentMove[MAX_PLY];
+	PieceType movedPiece[MAX_PLY];
+	Move killers[MAX_PLY][2] = {};
+	ButterflyHistory history = {};
+	CounterMoveTable counterMoves = {};
+	PawnTable &pawns;
+
+	// Beta cutoffs, and how many of them came from the first move searched
+	uint64_t cutoffs = 0;
+	uint64_t firstMoveCutoffs = 0;
+	uint64_t tbHits = 0;
+};
+
+// Function to split the clock into a soft target (don't start another iteration) and a hard limit
+void SearchWorker::setTimeBudget()
+{
+	Color us = position.sideToMove();
+
+	// A fixed move time has no clock to save for later moves, so it is spent in full: no soft
+	// target, the search runs until the hard limit and keeps the last completed iteration
+	if (limits.moveTime > 0)
+	{
+		maximumTime = limits.moveTime;
+		return;
+	}
+	if (limits.time[us] <= 0)
+		return;
+
+	const int64_t overhead = 30;
+	int64_t remaining = std::max<int64_t>(limits.time[us] - overhead, 1);
+	int movesLeft = limits.movesToGo > 0 ? std::min(limits.movesToGo, 40) : 30;
+
+	optimumTime = remaining / movesLeft + limits.increment[us] * 3 / 4;
+	maximumTime = std::min(optimumTime * 4, remaining * 4 / 5);
+	optimumTime = std::min(optimumTime, maximumTime);
+}
+
+uint64_t SearchWorker::totalNodes() const
+{
+	uint64_t total = 0;
+	for (const std::unique_ptr<SearchWorker> &worker : pool)
+		total += worker->nodeCount();
+	return total;
+}
+
+// Function to check the limits. Only the main thread watches the clock and node count,
+// helpers stop when the main thread raises the shared flag
+bool SearchWorker::shouldStop()
+{
+	if (stopped)
+		return true;
+
+	if (stop.load(std::memory_order_relaxed))
+		stopped = true;
+	else if (id == 0 && (nodeCount() & 1023) == 0)
+	{
+		if (limits.nodes && totalNodes() >= limits.nodes)
+			stopped = true;
+		else if (maximumTime && !limits.infinite && !pondering.load(std::memory_order_relaxed) && elapsed() >= maximumTime)
+			stopped = true;
+	}
+	return stopped;
+}
+
+// Function to reward the quiet move that cut off and penalise the quiets searched before it.
+// History bonuses shrink as the entry nears MAX_HISTORY so no entry runs away
+void SearchWorker::updateQuietStats(Move move, int ply, int depth, const Move quietsTried[], int quietCount)
+{
+	if (killers[ply][0] != move)
+	{
+		killers[ply][1] = killers[ply][0];
+		killers[ply][0] = move;
+	}
+
+	Color us = position.sideToMove();
+	int bonus = std::min(depth * depth, 1200);
+	auto update = [&](Move quiet, int amount)
+	{
+		int &entry = history[us][moveFrom(quiet)][moveTo(quiet)];
+		entry += amount - entry * std::abs(amount) / MAX_HISTORY;
+	};
+
+	update(move, bonus);
+	for (int i = 0; i < quietCount; i++)
+	{
+		if (quietsTried[i] != move)
+			update(quietsTried[i], -bonus);
+	}
+
+	if (ply > 0 && currentMove[ply - 1] != MOVE_NONE)
+		counterMoves[movedPiece[ply - 1]][moveTo(currentMove[ply - 1])] = move;
+}
+
+int SearchWorker::quiescence(int alpha, int beta, int ply)
+{
+	pvLength[ply] = ply;
+	if (shouldStop())
+		return 0;
+
+	countNode();
+	if (ply >= MAX_PLY - 1)
+		return evaluate(position, pawns);
+
+	bool inCheck = position.inCheck();
+	int best = -VALUE_INFINITE;
+
+	// Stand pat: the side to move can usually do at least as well as the static score
+	if (!inCheck)
+	{
+		best = evaluate(position, pawns);
+		if (best >= beta)
+			return best;
+		// Delta pruning: not even winning a queen would bring the score up to alpha. A pawn about
+		// to promote can gain more than that, so those positions are searched anyway
+		Color us = position.sideToMove();
+		Bitboard promoting = position.pieces(us, PAWN) & (us == WHITE ? RANK_7_BB : RANK_2_BB);
+		if (!promoting && best + PIECE_VALUES[QUEEN] + DELTA_MARGIN < alpha)
+			return best;
+		alpha = std::max(alpha, best);
+	}
+
+	MovePicker picker(position, history);
+	int moveCount = 0;
+	Move move;
+
+	while ((move = picker.next()) != MOVE_NONE)
+	{
+		moveCount++;
+
+		if (!inCheck)
+		{
+			// Delta pruning per capture: skip it when the captured piece plus a margin cannot reach alpha
+			if (!isPromotion(move))
+			{
+				PieceKind victim = moveFlags(move) == EP_CAPTURE ? PAWN : pieceKind(position.pieceOn(moveTo(move)));
+				if (best + PIECE_VALUES[victim] + DELTA_MARGIN <= alpha)
+					continue;
+			}
+			// Captures that lose material in the exchange cannot help at the leaves
+			if (position.losesExchange(move))
+				continue;
+		}
+
+		makeMove(move, ply);
+		int score = -quiescence(-beta, -alpha, ply + 1);
+		game.undo();
+
+		if (stopped)
+			return 0;
+
+		if (score > best)
+		{
+			best = score;
+			if (score > alpha)
+			{
+				alpha = score;
+				if (alpha >= beta)
+					break;
+			}
+		}
+	}
+
+	if (inCheck && moveCount == 0)
+		return -VALUE_MATE + ply;
+	return best;
+}
+
+int SearchWorker::search(int alpha, int beta, int depth, int ply, bool nullAllowed)
+{
+	const bool pvNode = beta - alpha > 1;
+	const bool rootNode = ply == 0;
+	pvLength[ply] = ply;
+
+	if (depth <= 0)
+		return quiescence(alpha, beta, ply);
+
+	if (shouldStop())
+		return 0;
+
+	countNode();
+	selDepth = std::max(selDepth, ply);
+
+	if (!rootNode)
+	{
+		if (game.isDraw())
+			return VALUE_DRAW;
+		if (ply >= MAX_PLY - 1)
+			return evaluate(position, pawns);
+
+		// Mate distance pruning: no line from here can beat a shorter mate already found
+		alpha = std::max(alpha, -VALUE_MATE + ply);
+		beta = std::min(beta, VALUE_MATE - ply - 1);
+		if (alpha >= beta)
+			return alpha;
+
+		// An endgame table knows the exact distance to mate, there is nothing left to search
+		TbResult tbResult;
+		if (popcount(position.occupied()) <= TB.maxPieces() && TB.probe(position, tbResult) && isTablebaseResultExact(tbResult, position.halfmoves()))
+		{
+			tbHits++;
+			return tablebaseScore(tbResult, ply);
+		}
+	}
+
+	TTData tt;
+	bool ttHit = TT.probe(position.key(), tt);
+	Move ttMove = ttHit ? tt.move : MOVE_NONE;
+	int ttScore = ttHit ? scoreFromTT(tt.score, ply) : 0;
+
+	if (ttHit && !pvNode && tt.depth >= depth && (tt.bound == BOUND_EXACT || (tt.bound == BOUND_LOWER && ttScore >= beta) || (tt.bound == BOUND_UPPER && ttScore <= alpha)))
+		return ttScore;
+
+	const bool inCheck = position.inCheck();
+	const Color us = position.sideToMove();
+	int staticEval = inCheck ? -VALUE_INFINITE : ttHit ? tt.eval : evaluate(position, pawns);
+
+	if (!pvNode && !inCheck)
+	{
+		// Reverse futility: far enough above beta that a shallow search will not fall back below it
+		if (depth <= 6 && staticEval - 80 * depth >= beta && std::abs(beta) < VALUE_MATE_IN_MAX_PLY)
+			return staticEval;
+
+		// Null move: if passing still fails high, a real move will too. Skipped without pieces because of zugzwang
+		if (nullAllowed && depth >= 3 && staticEval >= beta && position.hasNonPawnMaterial(us))
+		{
+			int reduction = 3 + depth / 4;
+			currentMove[ply] = MOVE_NONE;
+			game.makeNullMove();
+			int score = -search(-beta, -beta + 1, depth - 1 - reduction, ply + 1, false);
+			game.undo();
+
+			if (stopped)
+				return 0;
+			if (score >= beta)
+				return score >= VALUE_MATE_IN_MAX_PLY ? beta : score;
+		}
+	}
+
+	Move counterMove = ply > 0 && currentMove[ply - 1] != MOVE_NONE ? counterMoves[movedPiece[ply - 1]][moveTo(currentMove[ply - 1])] : MOVE_NONE;
+	MovePicker picker(position, ttMove, killers[ply], counterMove, history);
+
+	const int originalAlpha = alpha;
+	int best = -VALUE_INFINITE;
+	Move bestMove = MOVE_NONE;
+	int moveCount = 0;
+	Move quietsTried[64];
+	int quietCount = 0;
+	Move move;
+
+	while ((move = picker.next()) != MOVE_NONE)
+	{
+		bool quiet = !isCapture(move) && !isPromotion(move);
+		moveCount++;
+
+		makeMove(move, ply);
+
+		bool givesCheck = position.inCheck();
+		int newDepth = depth - 1 + (givesCheck ? 1 : 0);
+		int score;
+
+		if (moveCount == 1)
+			score = -search(-beta, -alpha, newDepth, ply + 1, true);
+		else
+		{
+			// Late quiet moves are searched shallower with a null window first, and only
+			// re-searched at full depth and width when they unexpectedly beat alpha
+			int reduction = 0;
+			if (depth >= 3 && quiet && !inCheck && !givesCheck && moveCount > (pvNode ? 3 : 1))
+				reduction = std::max(0, std::min(Reductions.get(depth, moveCount) - (pvNode ? 1 : 0), newDepth - 1));
+
+			score = -search(-alpha - 1, -alpha, newDepth - reduction, ply + 1, true);
+			if (score > alpha && reduction)
+				score = -search(-alpha - 1, -alpha, newDepth, ply + 1, true);
+			if (score > alpha && score < beta)
+				score = -search(-beta, -alpha, newDepth, ply + 1, true);
+		}
+
+		game.undo();
+
+		if (stopped)
+			return 0;
+
+		if (score > best)
+		{
+			best = score;
+			bestMove = move;
+
+			if (score > alpha)
+			{
+				alpha = score;
+				pv[ply][ply] = move;
+				for (int next = ply + 1; next < pvLength[ply + 1]; next++)
+					pv[ply][next] = pv[ply + 1][next];
+				pvLength[ply] = pvLength[ply + 1];
+
+				if (alpha >= beta)
+				{
+					cutoffs++;
+					if (moveCount == 1)
+						firstMoveCutoffs++;
+					if (quiet)
+						updateQuietStats(move, ply, depth, quietsTried, quietCount);
+					break;
+				}
+			}
+		}
+
+		if (quiet && quietCount < 64)
+			quietsTried[quietCount++] = move;
+	}
+
+	if (moveCount == 0)
+		return inCheck ? -VALUE_MATE + ply : VALUE_DRAW;
+
+	Bound bound = best >= beta ? BOUND_LOWER : best > originalAlpha ? BOUND_EXACT : BOUND_UPPER;
+	TT.store(position.key(), bestMove, scoreToTT(best, ply), staticEval == -VALUE_INFINITE ? 0 : staticEval, depth, bound);
+	return best;
+}
+
+SearchResult SearchWorker::iterate(const std::function<void(const SearchResult &)> &onIteration)
+{
+	SearchResult result;
+	MoveList rootMoves;
+	position.generateLegalMoves(rootMoves);
+	if (rootMoves.size() == 0)
+		return result;
+
+	// Something to play even if we are stopped before the first iteration completes
+	result.bestMove = rootMoves.moves[0];
+	int score = 0;
+
+	// With the root in an endgame table every move is scored exactly from depth 2 on, where its
+	// position gets probed instead of going into the quiescence search
+	TbResult tbResult;
+	const bool rootInTablebase = popcount(position.occupied()) <= TB.maxPieces() && TB.probe(position, tbResult) &&
+								 isTablebaseResultExact(tbResult, position.halfmoves());
+
+	for (int depth = 1; depth <= limits.depth && depth < MAX_PLY; depth++)
+	{
+		if (id > 0)
+		{
+			int i = (id - 1) % 20;
+			if (((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2)
+				continue;
+		}
+
+		selDepth = 0;
+
+		// Aspiration window around the last score, widened on each fail until the score fits
+		int delta = 25;
+		int alpha = -VALUE_INFINITE, beta = VALUE_INFINITE;
+		if (depth >= 4)
+		{
+			alpha = std::max(score - delta, -VALUE_INFINITE);
+			beta = std::min(score + delta, int(VALUE_INFINITE));
+		}
+
+		while (true)
+		{
+			int value = search(alpha, beta, depth, 0, false);
+			if (stopped)
+				break;
+
+			if (value <= alpha)
+			{
+				beta = (alpha + beta) / 2;
+				alpha = std::max(value - delta, -VALUE_INFINITE);
+			}
+			else if (value >= beta)
+				beta = std::min(value + delta, int(VALUE_INFINITE));
+			else
+			{
+				score = value;
+				break;
+			}
+			delta += delta / 2;
+		}
+
+		if (stopped)
+			break;
+
+		result.depth = depth;
+		result.selDepth = selDepth;
+		result.score = score;
+		result.pv.assign(pv[0], pv[0] + pvLength[0]);
+		result.bestMove = result.pv.empty() ? result.bestMove : result.pv[0];
+		result.ponderMove = result.pv.size() > 1 ? result.pv[1] : MOVE_NONE;
+		result.nodes = totalNodes();
+		result.timeMs = elapsed();
+		result.cutoffs = cutoffs;
+		result.firstMoveCutoffs = firstMoveCutoffs;
+		result.tbHits = tbHits;
+		if (id == 0)
+		{
+			result.hashfull = TT.hashfull();
+			if (onIteration)
+				onIteration(result);
+		}
+
+		// A forced mate will not get any better and a new iteration is unlikely to finish past the soft limit.
+		// Helpers keep going until the main thread stops them
+		if (id == 0 && !limits.infinite && !pondering.load(std::memory_order_relaxed) && ((rootInTablebase ? depth >= 2 : std::abs(score) >= VALUE_MATE_IN_MAX_PLY) || (optimumTime && elapsed() > optimumTime / 2)))
+			break;
+	}
+
+	// A pondering search must not return before the ponder hit or stop, even with nothing left to search
+	while (id == 0 && !stopped && pondering.load(std::memory_order_relaxed) && !stop.load(std::memory_order_relaxed))
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	// Without a second PV move (cut short by a hash hit) the hash table may still know the expected reply
+	if (id == 0 && result.ponderMove == MOVE_NONE && result.bestMove != MOVE_NONE)
+	{
+		TTData tt;
+		game.makeMove(result.bestMove);
+		if (TT.probe(position.key(), tt) && position.isLegal(tt.move))
+			result.ponderMove = tt.move;
+		game.undo();
+	}
+
+	result.nodes = totalNodes();
+	result.timeMs = elapsed();
+	return result;
+}
+
+void Search::setThreads(int count)
+{
+	threadCount = std::max(1, std::min(count, MAX_THREADS));
+}
+
+SearchResult Search::run(const Position &position, const std::vector<uint64_t> &history, const SearchLimits &limits)
+{
+	TT.newSearch();
+	pawnTables.resize(threadCount);
+	for (PawnTable &pawns : pawnTables)
+		pawns.resetCounts();
+
+	// Workers carry the PV tables, keep them off the stack
+	WorkerPool pool;
+	for (int id = 0; id < threadCount; id++)
+		pool.emplace_back(new SearchWorker(id, position, history, limits, stopRequested, pondering, pool, pawnTables[id]));
+
+	// Lazy SMP: helpers search the same root and only talk to the main thread through the
+	// transposition table. The main thread decides when to stop and its move is played
+	std::vector<std::thread> helpers;
+	for (int id = 1; id < threadCount; id++)
+		helpers.emplace_back([&pool, id]()
+							 { pool[id]->iterate(nullptr); });
+
+	SearchResult result = pool[0]->iterate(onIteration);
+
+	stopRequested.store(true, std::memory_order_relaxed);
+	for (std::thread &helper : helpers)
+		helper.join();
+	stopRequested.store(false, std::memory_order_relaxed);
+	pondering.store(false, std::memory_order_relaxed);
+
+	// The helpers have finished, so their counters can be read without synchronisation
+	result.nodes = result.cutoffs = result.firstMoveCutoffs = result.tbHits = result.pawnProbes = result.pawnHits = 0;
+	for (const std::unique_ptr<SearchWorker> &worker : pool)
+	{
+		result.pawnProbes += worker->pawnTable().probes();
+		result.pawnHits += worker->pawnTable().hits();
+		result.nodes += worker->nodeCount();
+		result.tbHits += worker->tbHitCount();
+		result.cutoffs += worker->cutoffCount();
+		result.firstMoveCutoffs += worker->firstMoveCutoffCount();
+	}
+	return result;
+}
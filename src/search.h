@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "pawns.h"
+#include "position.h"
+
+const int MAX_PLY = 128;
+const int VALUE_DRAW = 0;
+const int VALUE_MATE = 32000;
+const int VALUE_INFINITE = 32001;
+// Mate scores run from VALUE_MATE down to here: a mate MAX_PLY plies from the root, or a tablebase
+// mate of up to 125 moves (TB_MAX_MATE) probed at a node that deep
+const int MAX_MATE_PLIES = MAX_PLY + 2 * 125;
+const int VALUE_MATE_IN_MAX_PLY = VALUE_MATE - MAX_MATE_PLIES;
+const int MAX_THREADS = 256;
+
+// Any combination may be set, the search stops at whichever limit is hit first
+struct SearchLimits
+{
+	int depth = MAX_PLY - 1;
+	uint64_t nodes = 0;			  // 0 means no node limit
+	int64_t moveTime = 0;		  // fixed time for this move in ms, 0 means not set
+	int64_t time[2] = {0, 0};	  // remaining clock of each color in ms
+	int64_t increment[2] = {0, 0}; // increment per move in ms
+	int movesToGo = 0;			  // moves until the next time control, 0 means sudden death
+	bool infinite = false;		  // only stop when asked to
+};
+
+struct SearchResult
+{
+	Move bestMove = MOVE_NONE;
+	Move ponderMove = MOVE_NONE;
+	int score = 0;
+	int depth = 0;
+	int selDepth = 0;
+	uint64_t nodes = 0;
+	int64_t timeMs = 0;
+	int hashfull = 0;
+	uint64_t tbHits = 0; // endgame table probes that ended a node
+	// Pawn structure cache lookups of the handcrafted evaluation, and how many found their entry
+	uint64_t pawnProbes = 0;
+	uint64_t pawnHits = 0;
+	std::vector<Move> pv;
+
+	// Move ordering quality: beta cutoffs, and how many came from the first move tried
+	uint64_t cutoffs = 0;
+	uint64_t firstMoveCutoffs = 0;
+};
+
+// Iterative deepening principal variation search with aspiration windows, optionally run
+// on several threads sharing the transposition table (Lazy SMP)
+class Search
+{
+public:
+	// Searches position and returns the best move found. history holds the keys of the game
+	// positions played before it, so repetitions of earlier positions are scored as draws
+	SearchResult run(const Position &position, const std::vector<uint64_t> &history, const SearchLimits &limits);
+
+	// Asks a running search to return as soon as possible, safe to call from any thread. A stop
+	// that arrives while no search runs ends the next run at once, clearStop() drops it
+	void stop() { stopRequested.store(true, std::memory_order_relaxed); }
+	void clearStop() { stopRequested.store(false, std::memory_order_relaxed); }
+
+	// Pondering: a run started with pondering set searches the expected position on the opponent's
+	// time, ignoring its time limits until ponderHit(). The clock still counts from the start of
+	// the run, so a long ponder lets the move come straight after the hit. Set before run()
+	void setPondering(bool value) { pondering.store(value, std::memory_order_relaxed); }
+	void ponderHit() { pondering.store(false, std::memory_order_relaxed); }
+
+	// Number of Lazy SMP threads used by the next run, the calling thread included
+	void setThreads(int count);
+	int threads() const { return threadCount; }
+
+	// Called after every completed iteration, from the searching thread
+	std::function<void(const SearchResult &)> onIteration;
+
+private:
+	std::atomic<bool> stopRequested{false};
+	std::atomic<bool> pondering{false};
+	int threadCount = 1;
+	// Pawn cache of each thread index, kept from run to run because its entries only depend on the pawns
+	std::vector<PawnTable> pawnTables;
+};
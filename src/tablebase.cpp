@@ -0,0 +1,291 @@
+#include "tablebase.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+Tablebases TB;
+
+// Letters of a table name strongest first, the order pieces are listed in
+static const char TB_LETTERS[] = "QRBNP";
+static const PieceKind TB_KINDS[] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+static const int TB_VALUES[] = {9, 5, 3, 3, 1};
+
+// Squares the white king is kept on in tables without pawns, a1-d1-d4 triangle
+static const int TRIANGLE_SQUARES[10] = {SQ_A1, SQ_B1, SQ_C1, SQ_D1, SQ_B2, SQ_C2, SQ_D2, SQ_C3, SQ_D3, SQ_D4};
+
+static int triangleIndex(int sq)
+{
+	for (int i = 0; i < 10; i++)
+	{
+		if (TRIANGLE_SQUARES[i] == sq)
+			return i;
+	}
+	return 0;
+}
+
+// Function to sort the letters of one side after its king, returns false on anything but K then QRBNP
+static bool parseSide(const std::string &text, std::string &letters)
+{
+	if (text.empty() || text[0] != 'K')
+		return false;
+	letters.clear();
+	for (int i = 0; i < 5; i++)
+		letters.append(size_t(std::count(text.begin() + 1, text.end(), TB_LETTERS[i])), TB_LETTERS[i]);
+	return letters.size() == text.size() - 1;
+}
+
+// Function to decide which side a table name lists first: more material, then the stronger pieces
+static bool isStronger(const std::string &a, const std::string &b)
+{
+	int valueA = 0, valueB = 0;
+	for (char c : a)
+		valueA += TB_VALUES[std::strchr(TB_LETTERS, c) - TB_LETTERS];
+	for (char c : b)
+		valueB += TB_VALUES[std::strchr(TB_LETTERS, c) - TB_LETTERS];
+	if (valueA != valueB)
+		return valueA > valueB;
+
+	for (size_t i = 0; i < a.size() && i < b.size(); i++)
+	{
+		if (a[i] != b[i])
+			return std::strchr(TB_LETTERS, a[i]) < std::strchr(TB_LETTERS, b[i]);
+	}
+	return a.size() > b.size();
+}
+
+bool parseMaterial(const std::string &name, TbMaterial &material)
+{
+	size_t split = name.find('v');
+	std::string white, black;
+	if (split == std::string::npos || !parseSide(name.substr(0, split), white) || !parseSide(name.substr(split + 1), black))
+		return false;
+	if (white.size() + black.size() + 2 > size_t(TB_MAX_PIECES))
+		return false;
+	if (isStronger(black, white))
+		std::swap(white, black);
+
+	material.name = "K" + white + "vK" + black;
+	material.count = 0;
+	material.hasPawns = false;
+	material.pieces[material.count++] = WHITE_KING;
+	material.pieces[material.count++] = BLACK_KING;
+	for (int side = 0; side < 2; side++)
+	{
+		for (char c : side == 0 ? white : black)
+		{
+			PieceKind kind = TB_KINDS[std::strchr(TB_LETTERS, c) - TB_LETTERS];
+			material.pieces[material.count++] = makePiece(side == 0 ? WHITE : BLACK, kind);
+			material.hasPawns |= kind == PAWN;
+		}
+	}
+
+	material.size = (material.hasPawns ? 32 : 10) * 64;
+	for (int i = 2; i < material.count; i++)
+		material.size *= pieceKind(material.pieces[i]) == PAWN ? 48 : 64;
+	return true;
+}
+
+// Pawns never stand on the first or last rank, so their squares are counted from a2
+static uint64_t encode(const TbMaterial &material, int squares[])
+{
+	// Identical pieces are interchangeable: ordering them by square gives each set one index
+	for (int i = 2; i < material.count;)
+	{
+		int end = i + 1;
+		while (end < material.count && material.pieces[end] == material.pieces[i])
+			end++;
+		std::sort(squares + i, squares + end);
+		i = end;
+	}
+
+	uint64_t index = material.hasPawns ? uint64_t(fileOf(squares[0]) * 8 + rankOf(squares[0])) : uint64_t(triangleIndex(squares[0]));
+	index = index * 64 + uint64_t(squares[1]);
+	for (int i = 2; i < material.count; i++)
+		index = pieceKind(material.pieces[i]) == PAWN ? index * 48 + uint64_t(squares[i] - 8) : index * 64 + uint64_t(squares[i]);
+	return index;
+}
+
+static void mirror(int squares[], int count, int mask)
+{
+	for (int i = 0; i < count; i++)
+		squares[i] ^= mask;
+}
+
+static void transpose(int squares[], int count)
+{
+	for (int i = 0; i < count; i++)
+		squares[i] = makeSquare(rankOf(squares[i]), fileOf(squares[i]));
+}
+
+uint64_t tbIndex(const TbMaterial &material, const int squares[])
+{
+	int s[TB_MAX_PIECES];
+	std::copy(squares, squares + material.count, s);
+
+	if (fileOf(s[0]) > 3)
+		mirror(s, material.count, 7);
+	// Pawns only allow the left-right mirror
+	if (material.hasPawns)
+		return encode(material, s);
+
+	if (rankOf(s[0]) > 3)
+		mirror(s, material.count, 56);
+	if (rankOf(s[0]) > fileOf(s[0]))
+		transpose(s, material.count);
+	uint64_t index = encode(material, s);
+
+	// With the king on the diagonal the mirror along it is the same position, the smaller index is kept
+	if (rankOf(s[0]) == fileOf(s[0]))
+	{
+		transpose(s, material.count);
+		index = std::min(index, encode(material, s));
+	}
+	return index;
+}
+
+void tbSquares(const TbMaterial &material, uint64_t index, int squares[])
+{
+	for (int i = material.count - 1; i >= 2; i--)
+	{
+		if (pieceKind(material.pieces[i]) == PAWN)
+		{
+			squares[i] = int(index % 48) + 8;
+			index /= 48;
+		}
+		else
+		{
+			squares[i] = int(index % 64);
+			index /= 64;
+		}
+	}
+	squares[1] = int(index % 64);
+	index /= 64;
+	squares[0] = material.hasPawns ? makeSquare(int(index / 8), int(index % 8)) : TRIANGLE_SQUARES[index];
+}
+
+// Piece counts packed two bits per piece type, kings left out. Tables hold at most three of a kind
+static uint32_t materialKey(const int counts[13])
+{
+	uint32_t key = 0;
+	for (int piece = BLACK_PAWN; piece <= WHITE_KING; piece++)
+	{
+		if (pieceKind(PieceType(piece)) != KING)
+			key = key * 4 + uint32_t(std::min(counts[piece], 3));
+	}
+	return key;
+}
+
+static uint32_t materialKey(const Position &position)
+{
+	int counts[13] = {};
+	for (int piece = BLACK_PAWN; piece <= WHITE_KING; piece++)
+		counts[piece] = popcount(position.pieces(PieceType(piece)));
+	return materialKey(counts);
+}
+
+static uint32_t materialKey(const TbMaterial &material, bool flipped)
+{
+	int counts[13] = {};
+	for (int i = 0; i < material.count; i++)
+	{
+		PieceType piece = material.pieces[i];
+		counts[flipped ? makePiece(~pieceColor(piece), pieceKind(piece)) : piece]++;
+	}
+	return materialKey(counts);
+}
+
+bool Tablebases::add(const std::string &path)
+{
+	std::unique_ptr<Table> table(new Table);
+	std::string name = std::filesystem::path(path).stem().string();
+	if (!parseMaterial(name, table->material) || table->material.name != name)
+		return false;
+	if (!table->file.open(path))
+		return false;
+
+	const unsigned char *data = table->file.data();
+	uint64_t size = 0;
+	for (int i = 7; i >= 0; i--)
+		size = size << 8 | data[8 + i];
+	if (table->file.size() != TB_HEADER_SIZE + 2 * table->material.size || std::memcmp(data, TB_MAGIC, sizeof(TB_MAGIC)) != 0 || size != table->material.size)
+		return false;
+	table->values[WHITE] = data + TB_HEADER_SIZE;
+	table->values[BLACK] = data + TB_HEADER_SIZE + size;
+
+	byMaterial[materialKey(table->material, false)] = {table.get(), false};
+	uint32_t flippedKey = materialKey(table->material, true);
+	if (flippedKey != materialKey(table->material, false))
+		byMaterial[flippedKey] = {table.get(), true};
+	largest = std::max(largest, table->material.count);
+	tables.push_back(std::move(table));
+	return true;
+}
+
+int Tablebases::load(const std::string &directory)
+{
+	int found = 0;
+	std::error_code error;
+	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error))
+	{
+		if (entry.path().extension() == TB_EXTENSION && add(entry.path().string()))
+			found++;
+	}
+	return found;
+}
+
+void Tablebases::clear()
+{
+	byMaterial.clear();
+	tables.clear();
+	largest = 0;
+}
+
+bool Tablebases::probe(const Position &position, TbResult &result) const
+{
+	if (position.castling() || position.enPassantSquare() != SQ_NONE)
+		return false;
+	// Bare kings need no table
+	int pieceCount = popcount(position.occupied());
+	result = TbResult();
+	if (pieceCount == 2)
+		return true;
+	if (pieceCount > largest)
+		return false;
+	auto found = byMaterial.find(materialKey(position));
+	if (found == byMaterial.end())
+		return false;
+
+	const Table &table = *found->second.table;
+	bool flipped = found->second.flipped;
+	Bitboard remaining[13];
+	for (int piece = 0; piece < 13; piece++)
+		remaining[piece] = position.pieces(PieceType(piece));
+
+	// Flipped, the board is mirrored top to bottom and the colors swapped
+	int squares[TB_MAX_PIECES];
+	for (int i = 0; i < table.material.count; i++)
+	{
+		PieceType piece = table.material.pieces[i];
+		if (flipped)
+			piece = makePiece(~pieceColor(piece), pieceKind(piece));
+		int sq = popLsb(remaining[piece]);
+		squares[i] = flipped ? sq ^ 56 : sq;
+	}
+
+	Color side = flipped ? ~position.sideToMove() : position.sideToMove();
+	uint8_t value = table.values[side][tbIndex(table.material, squares)];
+	if (value == TB_INVALID)
+		return false;
+	if (value >= TB_LOSS)
+	{
+		result.wdl = -1;
+		result.movesToMate = value - TB_LOSS;
+	}
+	else if (value != TB_DRAW)
+	{
+		result.wdl = 1;
+		result.movesToMate = value;
+	}
+	return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedfile.h"
+#include "position.h"
+
+// Endgame tablebases: for every position of a small material set (the kings plus up to three more
+// pieces), whether the side to move wins, draws or loses with perfect play and how many moves the
+// mate takes. Built offline by tbgen, one file per material set, and memory mapped for probing.
+// Castling rights, en passant and the fifty move rule are not part of a table
+const int TB_MAX_PIECES = 5;
+
+// One byte per position, from the point of view of the side to move:
+//   TB_DRAW, 1 ... TB_MAX_MATE a win with mate in that many moves,
+//   TB_LOSS + n getting mated in n moves (n = 0: checkmated), TB_INVALID an index no position maps to
+const uint8_t TB_DRAW = 0;
+const int TB_MAX_MATE = 125;
+const uint8_t TB_LOSS = 128;
+const uint8_t TB_INVALID = 255;
+
+// Pieces of one table in index order: white king, black king, then the other white and black pieces
+// strongest first. White is always the stronger side, the weaker color probes with the board flipped
+struct TbMaterial
+{
+	std::string name; // KRPvKN
+	PieceType pieces[TB_MAX_PIECES];
+	int count = 0;
+	bool hasPawns = false;
+	uint64_t size = 0; // positions per side to move
+};
+
+// Parses a name like KRvKN, in either color order (KvKQ is the KQvK table). Returns false when it
+// is malformed or has more than TB_MAX_PIECES pieces
+bool parseMaterial(const std::string &name, TbMaterial &material);
+
+// Index of the position whose pieces (in TbMaterial::pieces order) stand on squares. The board
+// symmetries map every position to one canonical form first: mirrored so the white king is on the
+// a-d files and, without pawns, in the a1-d1-d4 triangle. Identical pieces are interchangeable
+uint64_t tbIndex(const TbMaterial &material, const int squares[]);
+// Squares of the pieces at index, the inverse of tbIndex for canonical positions. Other indexes
+// decode to a layout tbIndex maps elsewhere or to pieces sharing a square
+void tbSquares(const TbMaterial &material, uint64_t index, int squares[]);
+
+struct TbResult
+{
+	int wdl = 0;		 // 1 the side to move wins, 0 draw, -1 it loses
+	int movesToMate = 0; // full moves until mate with perfect play, 0 for draws
+};
+
+class Tablebases
+{
+public:
+	// Maps every table file (*.ctb) in directory, returns how many were found
+	int load(const std::string &directory);
+	// Maps one table file, returns false when it is missing or not a table
+	bool add(const std::string &path);
+	void clear();
+
+	// Most pieces (kings included) of any loaded table, 0 when none is loaded, so callers can skip
+	// probing with one comparison
+	int maxPieces() const { return largest; }
+	int tableCount() const { return int(tables.size()); }
+
+	// Returns false when no table covers position: too many pieces, a material set not loaded,
+	// castling rights or an en passant square
+	bool probe(const Position &position, TbResult &result) const;
+
+private:
+	struct Table
+	{
+		TbMaterial material;
+		MappedFile file;
+		const uint8_t *values[2];
+	};
+
+	struct Entry
+	{
+		const Table *table;
+		bool flipped; // the table's white is this position's black
+	};
+
+	std::vector<std::unique_ptr<Table>> tables;
+	std::unordered_map<uint32_t, Entry> byMaterial;
+	int largest = 0;
+};
+
+// Table file layout: TB_MAGIC (8 bytes), positions per side to move (uint64 little endian), then one
+// byte per position with white to move, then the same with black to move
+const char TB_MAGIC[8] = {'C', 'H', 'E', 'S', 'S', 'T', 'B', '1'};
+const size_t TB_HEADER_SIZE = 16;
+const std::string TB_EXTENSION = ".ctb";
+
+extern Tablebases TB;
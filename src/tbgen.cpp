@@ -0,0 +1,563 @@
+// Builds endgame tablebases by retrograde analysis, on every core. Positions are settled in rounds
+// by plies to mate: round 0 finds the mates, round r the positions mating in r plies (odd rounds,
+// one move leads to a position lost in r - 1) or getting mated in r plies (even rounds, every move
+// leads to a position won in fewer). A round only looks again at positions one move before those
+// settled in the previous round, found by moving pieces backwards, so each takes time in proportion
+// to what changes. Captures and promotions leave the table for a smaller one, built first and probed.
+// Whatever is still unsettled when a round settles nothing is a draw
+//   tbgen [-t threads] [-d directory] [-n pieces] [material...]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tablebase.h"
+
+typedef std::chrono::steady_clock Clock;
+
+const std::string DEFAULT_DIRECTORY = "res/tb";
+
+// Internal values next to the TB_ ones: a stalemate is a draw that is settled from the start, a
+// plain TB_DRAW still waits for a round to settle it
+const uint8_t SETTLED_DRAW = 254;
+// Conversion summary of a position with a capture or promotion that draws: it can never be lost
+const uint8_t NEVER_LOST = 255;
+
+// Plies to mate of a settled win or loss, -1 for anything else. Wins are odd, losses even
+static int pliesOf(uint8_t value)
+{
+	if (value >= 1 && value <= TB_MAX_MATE)
+		return 2 * value - 1;
+	if (value >= TB_LOSS && value <= TB_LOSS + TB_MAX_MATE)
+		return 2 * (value - TB_LOSS);
+	return -1;
+}
+
+static bool isLoss(uint8_t value)
+{
+	return value >= TB_LOSS && value <= TB_LOSS + TB_MAX_MATE;
+}
+
+// Function to run body(begin, end) over [0, count), in chunks the threads take in turn
+template <typename Body>
+static void parallelFor(uint64_t count, int threads, const Body &body)
+{
+	const uint64_t CHUNK = 4096;
+	std::atomic<uint64_t> next{0};
+	auto work = [&]()
+	{
+		uint64_t begin;
+		while ((begin = next.fetch_add(CHUNK, std::memory_order_relaxed)) < count)
+			body(begin, std::min(begin + CHUNK, count));
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threads; i++)
+		workers.emplace_back(work);
+	work();
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+static void atomicMax(std::atomic<int> &target, int value)
+{
+	int current = target.load(std::memory_order_relaxed);
+	while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		;
+}
+
+// Retrograde analysis of one material set. Every table a capture or promotion leads to must be
+// loaded in TB before run()
+class Generator
+{
+public:
+	Generator(const TbMaterial &material, int threads) : material(material), threads(threads)
+	{
+		uint64_t words = (material.size + 63) / 64;
+		for (int side = 0; side < 2; side++)
+		{
+			values[side].reset(new std::atomic<uint8_t>[material.size]);
+			convertWin[side].reset(new uint8_t[material.size]);
+			convertLoss[side].reset(new uint8_t[material.size]);
+			for (int parity = 0; parity < 2; parity++)
+			{
+				marks[parity][side].reset(new std::atomic<uint64_t>[words]);
+				for (uint64_t i = 0; i < words; i++)
+					marks[parity][side][i].store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns false when a table a conversion needs is missing
+	bool run();
+	bool write(const std::string &path) const;
+
+	// Longest mate in moves and positions won, drawn and lost for the side to move, valid after run()
+	int longestMate = 0;
+	uint64_t wins = 0, draws = 0, losses = 0;
+	// The format caps mates at TB_MAX_MATE moves, longer ones were left as draws
+	bool truncated = false;
+
+private:
+	bool setup(Color side, uint64_t index, int squares[], Position &position) const;
+	void initialize(Color side, uint64_t index, Position &position, int &latestRound);
+	bool settle(Color side, uint64_t index, int round, Position &position);
+	void markPredecessors(Color side, const int squares[], int nextRound);
+	void count();
+
+	const TbMaterial &material;
+	const int threads;
+	std::unique_ptr<std::atomic<uint8_t>[]> values[2];
+	// Round in which the best capture or promotion would win (0: none does), and the round after
+	// which they all lose (0: there is none, NEVER_LOST: one draws or wins)
+	std::unique_ptr<uint8_t[]> convertWin[2];
+	std::unique_ptr<uint8_t[]> convertLoss[2];
+	// Positions to look at in the next round, [round parity][side to move] bitsets
+	std::unique_ptr<std::atomic<uint64_t>[]> marks[2][2];
+	std::atomic<bool> missingTable{false};
+};
+
+// Only the canonical form of each position is kept, the other indexes stay TB_INVALID
+bool Generator::setup(Color side, uint64_t index, int squares[], Position &position) const
+{
+	tbSquares(material, index, squares);
+	return tbIndex(material, squares) == index && position.setFromPieces(material.pieces, squares, material.count, side);
+}
+
+void Generator::initialize(Color side, uint64_t index, Position &position, int &latestRound)
+{
+	int squares[TB_MAX_PIECES];
+	convertWin[side][index] = convertLoss[side][index] = 0;
+	if (!setup(side, index, squares, position))
+	{
+		values[side][index].store(TB_INVALID, std::memory_order_relaxed);
+		return;
+	}
+
+	MoveList moves;
+	position.generateLegalMoves(moves);
+	if (moves.size() == 0)
+	{
+		values[side][index].store(position.inCheck() ? TB_LOSS : SETTLED_DRAW, std::memory_order_relaxed);
+		if (position.inCheck())
+			markPredecessors(side, squares, 1);
+		return;
+	}
+	values[side][index].store(TB_DRAW, std::memory_order_relaxed);
+
+	int bestWin = 0, latestLoss = 0;
+	bool drawn = false;
+	for (Move move : moves)
+	{
+		if (!isCapture(move) && !isPromotion(move))
+			continue;
+		Position child = position;
+		UndoInfo undo;
+		child.makeMove(move, undo);
+		TbResult result;
+		if (!TB.probe(child, result))
+		{
+			missingTable.store(true, std::memory_order_relaxed);
+			return;
+		}
+		if (result.wdl < 0)
+			bestWin = bestWin ? std::min(bestWin, 2 * result.movesToMate + 1) : 2 * result.movesToMate + 1;
+		else if (result.wdl > 0)
+			latestLoss = std::max(latestLoss, 2 * result.movesToMate);
+		else
+			drawn = true;
+	}
+
+	convertWin[side][index] = uint8_t(bestWin);
+	convertLoss[side][index] = drawn || bestWin ? NEVER_LOST : uint8_t(latestLoss);
+	latestRound = std::max(latestRound, std::max(bestWin, drawn || bestWin ? 0 : latestLoss));
+}
+
+// Function to look at one unsettled position in round (its plies to mate if it settles now)
+bool Generator::settle(Color side, uint64_t index, int round, Position &position)
+{
+	int squares[TB_MAX_PIECES];
+	setup(side, index, squares, position);
+	const bool winRound = round % 2 == 1;
+	bool settled = winRound ? convertWin[side][index] && convertWin[side][index] <= round : convertLoss[side][index] != NEVER_LOST && convertLoss[side][index] <= round;
+
+	MoveList moves;
+	position.generateLegalMoves(moves);
+	int child[TB_MAX_PIECES];
+	for (Move move : moves)
+	{
+		if (settled == winRound)
+			break;
+		if (isCapture(move) || isPromotion(move))
+			continue;
+
+		std::copy(squares, squares + material.count, child);
+		for (int i = 0; i < material.count; i++)
+		{
+			if (child[i] == moveFrom(move))
+				child[i] = moveTo(move);
+		}
+		uint8_t value = values[~side][tbIndex(material, child)].load(std::memory_order_relaxed);
+		int plies = pliesOf(value);
+		// Positions settled in this round are left for the next one, they are not known yet to
+		// every thread
+		bool known = plies >= 0 && plies < round;
+		if (winRound && known && isLoss(value))
+			settled = true;
+		else if (!winRound && !(known && !isLoss(value)))
+			settled = false;
+	}
+
+	if (!settled)
+		return false;
+	values[side][index].store(winRound ? uint8_t((round + 1) / 2) : uint8_t(TB_LOSS + round / 2), std::memory_order_relaxed);
+	markPredecessors(side, squares, round + 1);
+	return true;
+}
+
+// Function to mark the positions one reversible move before this one (no capture, no promotion:
+// those come from a bigger table) for a look in nextRound. Some are not legal, they are skipped then
+void Generator::markPredecessors(Color side, const int squares[], int nextRound)
+{
+	const Color mover = ~side;
+	Bitboard occupied = 0;
+	for (int i = 0; i < material.count; i++)
+		occupied |= squareBB(squares[i]);
+
+	std::atomic<uint64_t> *bits = marks[nextRound % 2][mover].get();
+	int before[TB_MAX_PIECES];
+	std::copy(squares, squares + material.count, before);
+	for (int i = 0; i < material.count; i++)
+	{
+		PieceType piece = material.pieces[i];
+		if (pieceColor(piece) != mover)
+			continue;
+
+		int to = squares[i];
+		Bitboard origins = 0;
+		switch (pieceKind(piece))
+		{
+		case PAWN:
+		{
+			int forward = mover == WHITE ? 8 : -8;
+			int relativeRank = mover == WHITE ? rankOf(to) : 7 - rankOf(to);
+			if (relativeRank >= 2 && !(occupied & squareBB(to - forward)))
+			{
+				origins |= squareBB(to - forward);
+				if (relativeRank == 3)
+					origins |= squareBB(to - 2 * forward);
+			}
+			break;
+		}
+		case KNIGHT:
+			origins = knightAttacks(to);
+			break;
+		case BISHOP:
+			origins = bishopAttacks(to, occupied);
+			break;
+		case ROOK:
+			origins = rookAttacks(to, occupied);
+			break;
+		case QUEEN:
+			origins = queenAttacks(to, occupied);
+			break;
+		default:
+			origins = kingAttacks(to);
+			break;
+		}
+
+		origins &= ~occupied;
+		while (origins)
+		{
+			before[i] = popLsb(origins);
+			uint64_t index = tbIndex(material, before);
+			bits[index / 64].fetch_or(1ULL << (index % 64), std::memory_order_relaxed);
+		}
+		before[i] = to;
+	}
+}
+
+bool Generator::run()
+{
+	std::atomic<int> latestRound{0};
+	parallelFor(material.size, threads, [&](uint64_t begin, uint64_t end)
+				{
+		Position position;
+		int latest = 0;
+		for (uint64_t index = begin; index < end; index++)
+		{
+			initialize(WHITE, index, position, latest);
+			initialize(BLACK, index, position, latest);
+		}
+		atomicMax(latestRound, latest); });
+	if (missingTable.load())
+		return false;
+
+	const uint64_t words = (material.size + 63) / 64;
+	for (int round = 1; round <= 2 * TB_MAX_MATE; round++)
+	{
+		std::atomic<uint64_t> settledCount{0};
+		parallelFor(words, threads, [&](uint64_t begin, uint64_t end)
+					{
+			Position position;
+			uint64_t settled = 0;
+			for (uint64_t word = begin; word < end; word++)
+			{
+				for (int side = 0; side < 2; side++)
+				{
+					uint64_t bits = marks[round % 2][side][word].exchange(0, std::memory_order_relaxed);
+					// Conversions settle positions no move of this table leads to, they are looked at in the round they name
+					for (uint64_t index = word * 64; index < std::min(word * 64 + 64, material.size); index++)
+					{
+						bool marked = (bits >> (index % 64)) & 1;
+						if (!marked && convertWin[side][index] != round && convertLoss[side][index] != round)
+							continue;
+						if (values[side][index].load(std::memory_order_relaxed) == TB_DRAW && settle(Color(side), index, round, position))
+							settled++;
+					}
+				}
+			}
+			settledCount.fetch_add(settled, std::memory_order_relaxed); });
+
+		if (settledCount.load() == 0 && round >= latestRound.load())
+			break;
+		if (round == 2 * TB_MAX_MATE && settledCount.load() > 0)
+			truncated = true;
+	}
+
+	count();
+	return true;
+}
+
+void Generator::count()
+{
+	for (int side = 0; side < 2; side++)
+	{
+		for (uint64_t index = 0; index < material.size; index++)
+		{
+			uint8_t value = values[side][index].load(std::memory_order_relaxed);
+			if (value == TB_INVALID)
+				continue;
+			if (isLoss(value))
+				losses++;
+			else if (value >= 1 && value <= TB_MAX_MATE)
+			{
+				wins++;
+				longestMate = std::max(longestMate, int(value));
+			}
+			else
+				draws++;
+		}
+	}
+}
+
+bool Generator::write(const std::string &path) const
+{
+	std::ofstream out(path, std::ios::binary);
+	out.write(TB_MAGIC, sizeof(TB_MAGIC));
+	for (int i = 0; i < 8; i++)
+		out.put(char((material.size >> (8 * i)) & 0xFF));
+
+	std::vector<char> buffer;
+	buffer.reserve(1 << 20);
+	for (int side = 0; side < 2; side++)
+	{
+		for (uint64_t index = 0; index < material.size; index++)
+		{
+			uint8_t value = values[side][index].load(std::memory_order_relaxed);
+			buffer.push_back(char(value == SETTLED_DRAW ? TB_DRAW : value));
+			if (buffer.size() == buffer.capacity())
+			{
+				out.write(buffer.data(), std::streamsize(buffer.size()));
+				buffer.clear();
+			}
+		}
+	}
+	out.write(buffer.data(), std::streamsize(buffer.size()));
+	return bool(out);
+}
+
+static std::string nameOf(const PieceType pieces[], int count)
+{
+	static const char LETTERS[] = " PRNBQK";
+	std::string white = "K", black = "K";
+	for (int i = 0; i < count; i++)
+	{
+		if (pieceKind(pieces[i]) != KING)
+			(pieceColor(pieces[i]) == WHITE ? white : black) += LETTERS[pieceKind(pieces[i])];
+	}
+	return white + "v" + black;
+}
+
+// Materials one capture or promotion away, bare kings left out
+static std::vector<std::string> successors(const TbMaterial &material)
+{
+	static const PieceKind PROMOTIONS[4] = {QUEEN, ROOK, BISHOP, KNIGHT};
+	std::vector<std::string> names;
+	PieceType pieces[TB_MAX_PIECES];
+	for (int i = 2; i < material.count; i++)
+	{
+		std::copy(material.pieces, material.pieces + material.count, pieces);
+		if (material.count > 3)
+		{
+			std::swap(pieces[i], pieces[material.count - 1]);
+			names.push_back(nameOf(pieces, material.count - 1));
+		}
+		if (pieceKind(material.pieces[i]) != PAWN)
+			continue;
+		std::copy(material.pieces, material.pieces + material.count, pieces);
+		for (PieceKind kind : PROMOTIONS)
+		{
+			pieces[i] = makePiece(pieceColor(material.pieces[i]), kind);
+			names.push_back(nameOf(pieces, material.count));
+		}
+	}
+	return names;
+}
+
+// Every material set with up to pieces pieces, kings included, in build order (fewest pieces first)
+static std::vector<std::string> allMaterials(int pieces)
+{
+	const std::string letters = "QRBNP";
+	std::set<std::string> seen;
+	std::vector<std::string> names;
+	std::vector<std::string> sides = {""};
+	for (int extra = 1; extra <= pieces - 2; extra++)
+	{
+		// Sorted letter multisets of size extra, split in every way between the two sides
+		std::vector<std::string> longer;
+		for (const std::string &side : sides)
+		{
+			for (size_t i = side.empty() ? 0 : letters.find(side.back()); i < letters.size(); i++)
+				longer.push_back(side + letters[i]);
+		}
+		sides.insert(sides.end(), longer.begin(), longer.end());
+
+		for (const std::string &white : sides)
+		{
+			for (const std::string &black : sides)
+			{
+				TbMaterial material;
+				if (white.size() + black.size() == size_t(extra) && parseMaterial("K" + white + "vK" + black, material) && seen.insert(material.name).second)
+					names.push_back(material.name);
+			}
+		}
+	}
+	return names;
+}
+
+static std::string formatSize(uint64_t bytes)
+{
+	std::ostringstream text;
+	text << std::fixed << std::setprecision(1);
+	if (bytes >= (1ULL << 30))
+		text << double(bytes) / double(1ULL << 30) << " GB";
+	else if (bytes >= (1ULL << 20))
+		text << double(bytes) / double(1ULL << 20) << " MB";
+	else
+		text << double(bytes) / 1024.0 << " KB";
+	return text.str();
+}
+
+// Function to build name unless its file is already there, after everything it converts into
+static bool build(const std::string &name, const std::string &directory, int threads, std::set<std::string> &done)
+{
+	TbMaterial material;
+	if (!parseMaterial(name, material))
+	{
+		std::cerr << "bad material " << name << ", expected something like KRvKN with up to " << TB_MAX_PIECES << " pieces" << std::endl;
+		return false;
+	}
+	if (done.count(material.name))
+		return true;
+	for (const std::string &successor : successors(material))
+	{
+		if (!build(successor, directory, threads, done))
+			return false;
+	}
+	done.insert(material.name);
+
+	std::string path = directory + "/" + material.name + TB_EXTENSION;
+	if (TB.add(path))
+	{
+		std::cout << std::left << std::setw(8) << material.name << " already built" << std::endl;
+		return true;
+	}
+
+	Clock::time_point start = Clock::now();
+	Generator generator(material, threads);
+	if (!generator.run())
+	{
+		std::cerr << material.name << ": a table it converts into could not be probed" << std::endl;
+		return false;
+	}
+	if (!generator.write(path) || !TB.add(path))
+	{
+		std::cerr << "cannot write " << path << std::endl;
+		return false;
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	uint64_t total = generator.wins + generator.draws + generator.losses;
+	std::cout << std::left << std::setw(8) << material.name << std::right << std::fixed << std::setprecision(1)
+			  << std::setw(12) << total << " positions  "
+			  << std::setw(5) << 100.0 * double(generator.wins) / double(total) << "% won "
+			  << std::setw(5) << 100.0 * double(generator.draws) / double(total) << "% drawn "
+			  << std::setw(5) << 100.0 * double(generator.losses) / double(total) << "% lost  "
+			  << "longest mate " << std::setw(3) << generator.longestMate << "  "
+			  << std::setprecision(2) << std::setw(8) << seconds << " s  "
+			  << formatSize(TB_HEADER_SIZE + 2 * material.size) << std::endl;
+	if (generator.truncated)
+		std::cout << "         mates longer than " << TB_MAX_MATE << " moves were stored as draws" << std::endl;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+	std::string directory = DEFAULT_DIRECTORY;
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-t" && i + 1 < argc)
+			threads = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-d" && i + 1 < argc)
+			directory = argv[++i];
+		else if (arg == "-n" && i + 1 < argc)
+		{
+			for (const std::string &name : allMaterials(std::max(3, std::min(std::atoi(argv[++i]), TB_MAX_PIECES))))
+				names.push_back(name);
+		}
+		else
+			names.push_back(arg);
+	}
+	if (names.empty())
+	{
+		std::cerr << "usage: tbgen [-t threads] [-d directory] [-n pieces] [material...]" << std::endl;
+		return 1;
+	}
+
+	initBitboards();
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	std::set<std::string> done;
+	Clock::time_point start = Clock::now();
+	for (const std::string &name : names)
+	{
+		if (!build(name, directory, threads, done))
+			return 1;
+	}
+	std::cout << "done in " << std::fixed << std::setprecision(1) << std::chrono::duration<double>(Clock::now() - start).count() << " s" << std::endl;
+	return 0;
+}
@@ -0,0 +1,188 @@
+#include "tt.h"
+
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+TranspositionTable TT;
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+TranspositionTable::~TranspositionTable()
+{
+	release();
+}
+
+void TranspositionTable::release()
+{
+	if (!buckets)
+		return;
+#ifdef _WIN32
+	_aligned_free(buckets);
+#else
+	std::free(buckets);
+#endif
+	buckets = nullptr;
+	bucketCount = 0;
+}
+
+bool TranspositionTable::resize(size_t megabytes, bool useLargePages, int threads)
+{
+	release();
+
+	size_t count = megabytes * 1024 * 1024 / sizeof(TTBucket);
+	if (count == 0)
+		count = 1;
+
+	// Huge pages cut TLB misses on random probes into gigabyte tables
+	size_t alignment = useLargePages ? HUGE_PAGE_SIZE : alignof(TTBucket);
+	size_t bytes = (count * sizeof(TTBucket) + alignment - 1) / alignment * alignment;
+
+#ifdef _WIN32
+	void *memory = _aligned_malloc(bytes, alignment);
+#else
+	void *memory = std::aligned_alloc(alignment, bytes);
+#endif
+	if (!memory)
+		return false;
+
+	largePages = false;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	if (useLargePages)
+		largePages = madvise(memory, bytes, MADV_HUGEPAGE) == 0;
+#endif
+
+	buckets = static_cast<TTBucket *>(memory);
+	for (size_t i = 0; i < count; i++)
+		new (&buckets[i]) TTBucket();
+	bucketCount = count;
+	clear(threads);
+	return true;
+}
+
+// Function to zero the table, split over threads since touching gigabytes takes a while
+void TranspositionTable::clear(int threads)
+{
+	if (threads < 1)
+		threads = 1;
+
+	auto clearRange = [this](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			for (TTEntry &entry : buckets[i].entries)
+			{
+				entry.keyXorData.store(0, std::memory_order_relaxed);
+				entry.data.store(0, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	size_t chunk = bucketCount / threads;
+	for (int t = 0; t < threads; t++)
+	{
+		size_t begin = t * chunk;
+		size_t end = t == threads - 1 ? bucketCount : begin + chunk;
+		workers.emplace_back(clearRange, begin, end);
+	}
+	for (std::thread &worker : workers)
+		worker.join();
+
+	generation.store(0, std::memory_order_relaxed);
+}
+
+static uint64_t packData(Move move, int score, int eval, int depth, Bound bound, uint8_t generation)
+{
+	return uint64_t(move) | uint64_t(uint16_t(int16_t(score))) << 16 | uint64_t(uint16_t(int16_t(eval))) << 32 | uint64_t(uint8_t(int8_t(depth))) << 48 | uint64_t(bound) << 56 | uint64_t(generation) << 58;
+}
+
+static void unpackData(uint64_t data, TTData &out)
+{
+	out.move = Move(data & 0xFFFF);
+	out.score = int16_t(uint16_t(data >> 16));
+	out.eval = int16_t(uint16_t(data >> 32));
+	out.depth = int8_t(uint8_t(data >> 48));
+	out.bound = Bound((data >> 56) & 3);
+}
+
+bool TranspositionTable::probe(uint64_t key, TTData &out) const
+{
+	if (!buckets)
+		return false;
+
+	const TTBucket &bucket = buckets[bucketIndex(key)];
+	for (const TTEntry &entry : bucket.entries)
+	{
+		uint64_t data = entry.data.load(std::memory_order_relaxed);
+		if ((entry.keyXorData.load(std::memory_order_relaxed) ^ data) == key && data != 0)
+		{
+			unpackData(data, out);
+			return true;
+		}
+	}
+	return false;
+}
+
+void TranspositionTable::store(uint64_t key, Move move, int score, int eval, int depth, Bound bound)
+{
+	if (!buckets)
+		return;
+
+	TTBucket &bucket = buckets[bucketIndex(key)];
+	TTEntry *replace = &bucket.entries[0];
+	int worstValue = 1 << 30;
+	const uint8_t current = generation.load(std::memory_order_relaxed);
+
+	for (TTEntry &entry : bucket.entries)
+	{
+		uint64_t data = entry.data.load(std::memory_order_relaxed);
+		if ((entry.keyXorData.load(std::memory_order_relaxed) ^ data) == key)
+		{
+			// Same position: keep the old best move when the new search found none
+			if (move == MOVE_NONE)
+				move = Move(data & 0xFFFF);
+			replace = &entry;
+			break;
+		}
+
+		// Otherwise evict the shallowest entry, counting each generation of age as 8 plies
+		int age = (current - int(data >> 58)) & 63;
+		int value = int(int8_t(uint8_t(data >> 48))) - 8 * age;
+		if (data == 0)
+			value = -(1 << 20);
+		if (value < worstValue)
+		{
+			worstValue = value;
+			replace = &entry;
+		}
+	}
+
+	uint64_t data = packData(move, score, eval, depth, bound, current);
+	replace->keyXorData.store(key ^ data, std::memory_order_relaxed);
+	replace->data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const
+{
+	size_t samples = bucketCount < 250 ? bucketCount : 250;
+	int used = 0;
+	const uint8_t current = generation.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < samples; i++)
+	{
+		for (const TTEntry &entry : buckets[i].entries)
+		{
+			uint64_t data = entry.data.load(std::memory_order_relaxed);
+			if (data != 0 && int(data >> 58) == current)
+				used++;
+		}
+	}
+	return samples ? int(used * 1000 / (samples * 4)) : 0;
+}
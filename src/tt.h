@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "types.h"
+
+enum Bound
+{
+	BOUND_NONE = 0,
+	BOUND_UPPER = 1,
+	BOUND_LOWER = 2,
+	BOUND_EXACT = 3
+};
+
+// What a probe hands back to the search
+struct TTData
+{
+	Move move;
+	int score;
+	int eval;
+	int depth;
+	Bound bound;
+};
+
+// One 16 byte slot. The key is stored XORed with the data word, so when two threads write
+// the same slot at once the halves no longer match and the probe treats it as a miss
+struct TTEntry
+{
+	std::atomic<uint64_t> keyXorData;
+	std::atomic<uint64_t> data; // move 16 | score 16 | eval 16 | depth 8 | bound 2 | generation 6
+};
+
+// Four entries fill exactly one cache line, so a probe touches a single line
+struct alignas(64) TTBucket
+{
+	TTEntry entries[4];
+};
+
+// Shared transposition table. Probes and stores are lock free and safe from any number of search threads
+class TranspositionTable
+{
+public:
+	TranspositionTable() = default;
+	~TranspositionTable();
+	TranspositionTable(const TranspositionTable &) = delete;
+	TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+	// Reallocates and clears the table. With largePages the memory is 2 MB aligned and
+	// huge pages are requested through madvise where the OS supports it
+	bool resize(size_t megabytes, bool largePages = true, int threads = 1);
+	void clear(int threads = 1);
+
+	// Called once per search so entries from older searches are replaced first
+	void newSearch() { generation.store((generation.load(std::memory_order_relaxed) + 1) & 63, std::memory_order_relaxed); }
+
+	bool probe(uint64_t key, TTData &out) const;
+	void store(uint64_t key, Move move, int score, int eval, int depth, Bound bound);
+
+	// Pulls the bucket of key into cache ahead of the probe
+	void prefetch(uint64_t key) const
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(&buckets[bucketIndex(key)]);
+#endif
+	}
+
+	// Permille of sampled entries written by the current search
+	int hashfull() const;
+	size_t sizeInMegabytes() const { return bucketCount * sizeof(TTBucket) / (1024 * 1024); }
+	bool usesLargePages() const { return largePages; }
+
+private:
+	// Maps the key onto [0, bucketCount) with a multiply, so the size need not be a power of two
+	size_t bucketIndex(uint64_t key) const
+	{
+#if defined(__SIZEOF_INT128__)
+		return size_t((unsigned __int128)key * bucketCount >> 64);
+#else
+		return size_t(key % bucketCount);
+#endif
+	}
+
+	void release();
+
+	TTBucket *buckets = nullptr;
+	size_t bucketCount = 0;
+	bool largePages = false;
+	// Atomic because searches of different positions may run at once on the same table (the EPD runner)
+	std::atomic<uint8_t> generation{0};
+};
+
+extern TranspositionTable TT;
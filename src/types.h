@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+
+typedef uint64_t Bitboard;
+
+// Moves are packed in 16 bits: from (0-5), to (6-11) and flags (12-15)
+typedef uint16_t Move;
+
+const Move MOVE_NONE = 0;
+const int MAX_MOVES = 256;
+
+enum Color
+{
+	WHITE = 0,
+	BLACK = 1
+};
+
+inline Color operator~(Color color)
+{
+	return Color(color ^ 1);
+}
+
+// Colored pieces, shared by the renderer (pieces[piece - 1]) and the rules code
+enum PieceType
+{
+	EMPTY = 0,
+	BLACK_PAWN = 1,
+	BLACK_ROOK = 2,
+	BLACK_KNIGHT = 3,
+	BLACK_BISHOP = 4,
+	BLACK_QUEEN = 5,
+	BLACK_KING = 6,
+	WHITE_PAWN = 7,
+	WHITE_ROOK = 8,
+	WHITE_KNIGHT = 9,
+	WHITE_BISHOP = 10,
+	WHITE_QUEEN = 11,
+	WHITE_KING = 12,
+};
+
+// Piece without color, same ordering as PieceType
+enum PieceKind
+{
+	NO_KIND = 0,
+	PAWN = 1,
+	ROOK = 2,
+	KNIGHT = 3,
+	BISHOP = 4,
+	QUEEN = 5,
+	KING = 6
+};
+
+constexpr PieceType makePiece(Color color, PieceKind kind)
+{
+	return PieceType(color == WHITE ? kind + 6 : kind);
+}
+
+constexpr PieceKind pieceKind(PieceType piece)
+{
+	return PieceKind(piece > 6 ? piece - 6 : piece);
+}
+
+constexpr Color pieceColor(PieceType piece)
+{
+	return piece > 6 ? WHITE : BLACK;
+}
+
+// Squares are numbered a1 = 0 ... h8 = 63
+enum Square
+{
+	SQ_A1, SQ_B1, SQ_C1, SQ_D1, SQ_E1, SQ_F1, SQ_G1, SQ_H1,
+	SQ_A2, SQ_B2, SQ_C2, SQ_D2, SQ_E2, SQ_F2, SQ_G2, SQ_H2,
+	SQ_A3, SQ_B3, SQ_C3, SQ_D3, SQ_E3, SQ_F3, SQ_G3, SQ_H3,
+	SQ_A4, SQ_B4, SQ_C4, SQ_D4, SQ_E4, SQ_F4, SQ_G4, SQ_H4,
+	SQ_A5, SQ_B5, SQ_C5, SQ_D5, SQ_E5, SQ_F5, SQ_G5, SQ_H5,
+	SQ_A6, SQ_B6, SQ_C6, SQ_D6, SQ_E6, SQ_F6, SQ_G6, SQ_H6,
+	SQ_A7, SQ_B7, SQ_C7, SQ_D7, SQ_E7, SQ_F7, SQ_G7, SQ_H7,
+	SQ_A8, SQ_B8, SQ_C8, SQ_D8, SQ_E8, SQ_F8, SQ_G8, SQ_H8,
+	SQ_NONE
+};
+
+constexpr int fileOf(int sq)
+{
+	return sq & 7;
+}
+
+constexpr int rankOf(int sq)
+{
+	return sq >> 3;
+}
+
+constexpr int makeSquare(int file, int rank)
+{
+	return rank * 8 + file;
+}
+
+// The board is drawn with rank 8 on row 0, these convert between screen tiles and squares
+inline int squareFromTile(int row, int col)
+{
+	return (7 - row) * 8 + col;
+}
+
+inline int tileRow(int sq)
+{
+	return 7 - rankOf(sq);
+}
+
+inline int tileCol(int sq)
+{
+	return fileOf(sq);
+}
+
+enum CastlingRight
+{
+	WHITE_OO = 1,
+	WHITE_OOO = 2,
+	BLACK_OO = 4,
+	BLACK_OOO = 8,
+	ALL_CASTLING = 15
+};
+
+enum MoveFlag
+{
+	QUIET = 0,
+	DOUBLE_PAWN_PUSH = 1,
+	KING_CASTLE = 2,
+	QUEEN_CASTLE = 3,
+	CAPTURE = 4,
+	EP_CAPTURE = 5,
+	PROMOTION = 8, // + 0..3 for knight, bishop, rook, queen, + CAPTURE for promotion captures
+};
+
+inline Move encodeMove(int from, int to, int flags = QUIET)
+{
+	return Move(from | (to << 6) | (flags << 12));
+}
+
+inline int moveFrom(Move move)
+{
+	return move & 63;
+}
+
+inline int moveTo(Move move)
+{
+	return (move >> 6) & 63;
+}
+
+inline int moveFlags(Move move)
+{
+	return move >> 12;
+}
+
+inline bool isCapture(Move move)
+{
+	return (moveFlags(move) & CAPTURE) != 0;
+}
+
+inline bool isPromotion(Move move)
+{
+	return (moveFlags(move) & PROMOTION) != 0;
+}
+
+inline PieceKind promotionKind(Move move)
+{
+	static const PieceKind kinds[4] = {KNIGHT, BISHOP, ROOK, QUEEN};
+	return kinds[moveFlags(move) & 3];
+}
+
+inline int promotionFlag(PieceKind kind)
+{
+	return PROMOTION | (kind == KNIGHT ? 0 : kind == BISHOP ? 1 : kind == ROOK ? 2 : 3);
+}
+
+struct MoveList
+{
+	Move moves[MAX_MOVES];
+	int count = 0;
+
+	void add(Move move) { moves[count++] = move; }
+	const Move *begin() const { return moves; }
+	const Move *end() const { return moves + count; }
+	int size() const { return count; }
+};
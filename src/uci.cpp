@@ -0,0 +1,344 @@
+// Headless UCI front-end: the rules, search and engine thread of the SDL game driven by text
+// commands, for tournament managers, scripts and batch analysis.
+//
+// Three threads: this one blocks on stdin and turns each line into an engine call, the engine
+// thread searches, and the output thread sleeps on the engine's event ring and prints info and
+// bestmove lines. No command ever waits for a search, so stop and ponderhit reach the searching
+// threads as soon as the line is read, and the bestmove is printed as soon as it is published.
+//
+// "uci bench [depth]" searches the bench positions and exits, see runBench
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchpositions.h"
+#include "engine.h"
+#include "nnue.h"
+#include "position.h"
+#include "search.h"
+#include "tablebase.h"
+#include "tt.h"
+
+const char *ENGINE_NAME = "Chess";
+const char *ENGINE_AUTHOR = "the Chess authors";
+const int DEFAULT_HASH_MB = 64;
+const int MAX_HASH_MB = 65536;
+const std::string DEFAULT_NNUE_FILE = "res/nnue.bin";
+const std::string DEFAULT_TABLEBASE_DIRECTORY = "res/tb";
+const int EVENT_WAIT_MS = 50;
+const int BENCH_DEPTH = 11;
+
+static std::mutex outputMutex;
+
+// Function to write one line from either thread without interleaving
+static void send(const std::string &line)
+{
+	std::lock_guard<std::mutex> lock(outputMutex);
+	std::cout << line << std::endl;
+}
+
+// Function to write a score the UCI way: centipawns, or moves to mate (negative when getting mated)
+static std::string formatScore(int score)
+{
+	if (score >= VALUE_MATE_IN_MAX_PLY)
+		return "mate " + std::to_string((VALUE_MATE - score + 1) / 2);
+	if (score <= -VALUE_MATE_IN_MAX_PLY)
+		return "mate " + std::to_string(-(VALUE_MATE + score) / 2);
+	return "cp " + std::to_string(score);
+}
+
+static std::string formatInfo(const SearchResult &result)
+{
+	std::ostringstream line;
+	uint64_t nps = result.nodes * 1000 / uint64_t(std::max<int64_t>(result.timeMs, 1));
+	line << "info depth " << result.depth << " seldepth " << result.selDepth << " score " << formatScore(result.score)
+		 << " nodes " << result.nodes << " nps " << nps << " hashfull " << result.hashfull << " tbhits " << result.tbHits << " time " << result.timeMs;
+	if (!result.pv.empty())
+	{
+		line << " pv";
+		for (Move move : result.pv)
+			line << ' ' << moveToUci(move);
+	}
+	return line.str();
+}
+
+// Function run by the output thread: every go gets exactly one bestmove, in the order they were sent
+static void printEvents(Engine &engine, const std::atomic<bool> &quitting)
+{
+	EngineEvent event;
+	while (true)
+	{
+		if (!engine.waitForEvent(event, EVENT_WAIT_MS))
+		{
+			if (quitting.load(std::memory_order_acquire))
+				return;
+			continue;
+		}
+
+		if (!event.finished)
+		{
+			send(formatInfo(event.result));
+			continue;
+		}
+
+		std::string line = "bestmove " + moveToUci(event.result.bestMove);
+		if (event.result.bestMove != MOVE_NONE && event.result.ponderMove != MOVE_NONE)
+			line += " ponder " + moveToUci(event.result.ponderMove);
+		send(line);
+	}
+}
+
+// Function to let a search that was just stopped finish before touching state it reads (hash table, network)
+static void waitUntilIdle(const Engine &engine)
+{
+	while (engine.isSearching())
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+// bench [depth]: searches the bench positions on one thread, each from an empty hash table. The
+// total node count only changes when the search or evaluation does (or the Hash option, or the
+// network loaded), so it serves as a signature to tell functional changes from pure speedups
+static void runBench(int depth, int threads)
+{
+	Search search;
+	SearchLimits limits;
+	limits.depth = std::max(1, std::min(depth, MAX_PLY - 1));
+
+	uint64_t nodes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (const char *fen : BENCH_POSITIONS)
+	{
+		Position position;
+		position.setFromFen(fen);
+		TT.clear(threads);
+		nodes += search.run(position, std::vector<uint64_t>(), limits).nodes;
+	}
+	int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	send("Nodes searched: " + std::to_string(nodes));
+	send("Nodes/second: " + std::to_string(nodes * 1000 / uint64_t(std::max<int64_t>(ms, 1))));
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+static void parsePosition(std::istringstream &stream, Position &position, std::vector<uint64_t> &gameKeys)
+{
+	std::string token, fen;
+	stream >> token;
+	if (token == "startpos")
+	{
+		fen = START_FEN;
+		stream >> token;
+	}
+	else if (token == "fen")
+	{
+		while (stream >> token && token != "moves")
+			fen += token + " ";
+	}
+	else
+		return;
+
+	Position parsed;
+	if (!parsed.setFromFen(fen))
+	{
+		send("info string invalid fen " + fen);
+		return;
+	}
+
+	std::vector<uint64_t> keys;
+	while (token == "moves" && stream >> token)
+	{
+		if (token == "moves")
+			continue;
+		Move move = moveFromUci(parsed, token);
+		if (move == MOVE_NONE)
+		{
+			send("info string illegal move " + token);
+			break;
+		}
+		keys.push_back(parsed.key());
+		UndoInfo undo;
+		parsed.makeMove(move, undo);
+		token = "moves";
+	}
+
+	position = parsed;
+	gameKeys = std::move(keys);
+}
+
+// go [ponder] [wtime x] [btime x] [winc x] [binc x] [movestogo x] [depth x] [nodes x] [movetime x] [infinite]
+static SearchLimits parseGo(std::istringstream &stream, bool &ponder)
+{
+	SearchLimits limits;
+	std::string token;
+	ponder = false;
+
+	while (stream >> token)
+	{
+		if (token == "ponder")
+			ponder = true;
+		else if (token == "infinite")
+			limits.infinite = true;
+		else if (token == "wtime")
+			stream >> limits.time[WHITE];
+		else if (token == "btime")
+			stream >> limits.time[BLACK];
+		else if (token == "winc")
+			stream >> limits.increment[WHITE];
+		else if (token == "binc")
+			stream >> limits.increment[BLACK];
+		else if (token == "movestogo")
+			stream >> limits.movesToGo;
+		else if (token == "depth")
+			stream >> limits.depth;
+		else if (token == "nodes")
+			stream >> limits.nodes;
+		else if (token == "movetime")
+			stream >> limits.moveTime;
+	}
+
+	limits.depth = std::max(1, std::min(limits.depth, MAX_PLY - 1));
+	return limits;
+}
+
+// setoption name <name> value <value>, names are case insensitive
+static void parseSetOption(std::istringstream &stream, Engine &engine, int &threads, int &hashMb)
+{
+	std::string token, name, value;
+	stream >> token;
+	while (stream >> token && token != "value")
+		name += (name.empty() ? "" : " ") + token;
+	while (stream >> token)
+		value += (value.empty() ? "" : " ") + token;
+	for (char &c : name)
+		c = char(std::tolower(static_cast<unsigned char>(c)));
+
+	if (name == "threads")
+	{
+		threads = std::max(1, std::min(std::atoi(value.c_str()), MAX_THREADS));
+		engine.setThreads(threads);
+	}
+	else if (name == "hash")
+	{
+		hashMb = std::max(1, std::min(std::atoi(value.c_str()), MAX_HASH_MB));
+		waitUntilIdle(engine);
+		TT.resize(hashMb, true, threads);
+	}
+	else if (name == "evalfile")
+	{
+		waitUntilIdle(engine);
+		if (NNUE.load(value))
+			send("info string loaded network " + value + " (" + NNUE.simdName() + ")");
+		else
+			send("info string could not load network " + value + ", keeping " + (NNUE.loaded() ? "the previous network" : "the handcrafted evaluation"));
+	}
+	else if (name == "tablebasepath")
+	{
+		waitUntilIdle(engine);
+		TB.clear();
+		int count = TB.load(value);
+		send("info string found " + std::to_string(count) + " endgame tables in " + value);
+	}
+	else if (name != "ponder")
+		send("info string unknown option " + name);
+}
+
+int main(int argc, char *argv[])
+{
+	initBitboards();
+	std::ios::sync_with_stdio(false);
+	// cin flushes the stream it is tied to before every read, which would touch cout from this
+	// thread without the output lock
+	std::cin.tie(nullptr);
+
+	int threads = 1;
+	int hashMb = DEFAULT_HASH_MB;
+	NNUE.load(DEFAULT_NNUE_FILE);
+	TB.load(DEFAULT_TABLEBASE_DIRECTORY);
+	TT.resize(hashMb, true, threads);
+
+	if (argc > 1 && std::string(argv[1]) == "bench")
+	{
+		runBench(argc > 2 ? std::atoi(argv[2]) : BENCH_DEPTH, threads);
+		return 0;
+	}
+
+	Engine engine;
+	std::atomic<bool> quitting{false};
+	std::thread output(printEvents, std::ref(engine), std::cref(quitting));
+
+	Position position;
+	position.setStartPosition();
+	std::vector<uint64_t> gameKeys;
+	engine.setPosition(position, gameKeys);
+
+	std::string line;
+	while (std::getline(std::cin, line))
+	{
+		std::istringstream stream(line);
+		std::string command;
+		stream >> command;
+
+		if (command == "stop")
+			engine.stop();
+		else if (command == "ponderhit")
+			engine.ponderHit();
+		else if (command == "quit")
+			break;
+		else if (command == "uci")
+		{
+			send(std::string("id name ") + ENGINE_NAME);
+			send(std::string("id author ") + ENGINE_AUTHOR);
+			send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max " + std::to_string(MAX_HASH_MB));
+			send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+			send("option name Ponder type check default false");
+			send("option name EvalFile type string default " + DEFAULT_NNUE_FILE);
+			send("option name TablebasePath type string default " + DEFAULT_TABLEBASE_DIRECTORY);
+			send("uciok");
+		}
+		else if (command == "isready")
+			send("readyok");
+		else if (command == "setoption")
+			parseSetOption(stream, engine, threads, hashMb);
+		else if (command == "ucinewgame")
+		{
+			waitUntilIdle(engine);
+			TT.clear(threads);
+		}
+		else if (command == "position")
+		{
+			parsePosition(stream, position, gameKeys);
+			engine.setPosition(position, gameKeys);
+		}
+		else if (command == "go")
+		{
+			bool ponder;
+			SearchLimits limits = parseGo(stream, ponder);
+			engine.go(limits, ponder);
+		}
+		else if (command == "bench")
+		{
+			int depth = BENCH_DEPTH;
+			stream >> depth;
+			waitUntilIdle(engine);
+			runBench(depth, threads);
+		}
+		else if (!command.empty())
+			send("info string unknown command " + command);
+	}
+
+	// Searches still running are cut short but still answer with their bestmove, so a script piping
+	// "go" and then closing stdin gets a move
+	engine.stop();
+	waitUntilIdle(engine);
+	quitting.store(true, std::memory_order_release);
+	output.join();
+	return 0;
+}
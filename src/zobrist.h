@@ -0,0 +1,41 @@
+#pragma once
+
+#include "types.h"
+
+// Random keys XORed together to give every position a 64 bit signature. Generated at
+// compile time so every binary (game, perft, engine) agrees on the same keys
+struct ZobristKeys
+{
+	uint64_t psq[13][64];
+	uint64_t castling[16];
+	uint64_t enPassant[8];
+	uint64_t side;
+};
+
+constexpr uint64_t zobristNext(uint64_t &state)
+{
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 2685821657736338717ULL;
+}
+
+constexpr ZobristKeys makeZobristKeys()
+{
+	ZobristKeys keys = {};
+	uint64_t state = 1070372ULL;
+
+	for (int piece = BLACK_PAWN; piece <= WHITE_KING; piece++)
+	{
+		for (int sq = 0; sq < 64; sq++)
+			keys.psq[piece][sq] = zobristNext(state);
+	}
+	for (int rights = 1; rights < 16; rights++)
+		keys.castling[rights] = zobristNext(state);
+	for (int file = 0; file < 8; file++)
+		keys.enPassant[file] = zobristNext(state);
+	keys.side = zobristNext(state);
+	return keys;
+}
+
+constexpr ZobristKeys ZOBRIST = makeZobristKeys();